@@ -0,0 +1,341 @@
+#include <nii_volume.h>
+#include <sphere.h>
+#include <spherical_harmonic.h>
+#include <sh_field.h>
+#include <thread_pool.h>
+#include <utils.hpp>
+#include <args/args.hxx>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+const int DEFAULT_GRID_SIZE = 64;
+const int DEFAULT_NB_SH_COEFFS = 45;
+const int DEFAULT_SPHERE_RESOLUTION = 3;
+const int DEFAULT_NB_REPEATS = 5;
+const int NB_TENSOR_COEFFS = 6;
+const unsigned int RANDOM_SEED = 42;
+
+/// Result of a kernel benchmark.
+struct Result
+{
+    /// Name of the kernel.
+    std::string Kernel;
+
+    /// Number of threads running the kernel.
+    unsigned int NbThreads;
+
+    /// Number of items processed per run.
+    size_t NbItems;
+
+    /// Best time of all runs, in seconds.
+    double Seconds;
+};
+
+/// Time a function, keeping the best of several runs.
+/// \param[in] nbRepeats Number of runs.
+/// \param[in] fn Function to time.
+/// \return The best time, in seconds.
+double timeBest(int nbRepeats, const std::function<void()>& fn)
+{
+    double best = std::numeric_limits<double>::max();
+    for(int i = 0; i < nbRepeats; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+/// Thread counts to benchmark: powers of two up to maxThreads, and maxThreads.
+/// \param[in] maxThreads Maximum number of threads.
+/// \return The thread counts.
+std::vector<unsigned int> getThreadCounts(unsigned int maxThreads)
+{
+    std::vector<unsigned int> counts;
+    for(unsigned int n = 1; n < maxThreads; n *= 2)
+    {
+        counts.push_back(n);
+    }
+    counts.push_back(maxThreads);
+    return counts;
+}
+
+/// Write a synthetic 4D float image.
+/// \param[in] path Path of the image.
+/// \param[in] gridSize Number of voxels along each axis.
+/// \param[in] nbCoeffs Number of values per voxel.
+void writeSyntheticImage(const std::string& path, int gridSize, int nbCoeffs)
+{
+    int dims[8] = {4, gridSize, gridSize, gridSize, nbCoeffs, 1, 1, 1};
+    nifti_image* image = nifti_make_new_nim(dims, DT_FLOAT32, 1);
+    std::mt19937 generator(RANDOM_SEED);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    float* data = static_cast<float*>(image->data);
+    for(size_t i = 0; i < image->nvox; ++i)
+    {
+        data[i] = distribution(generator);
+    }
+    nifti_set_filenames(image, path.c_str(), 0, 1);
+    nifti_image_write(image);
+    nifti_image_free(image);
+}
+}
+
+int main(int argc, char** argv)
+{
+    args::ArgumentParser parser("CPU micro-benchmarks of dmriexplorer hot kernels. "
+                                "Results are written to stdout as JSON.",
+                                "dmri-explorer - Real-time Diffusion MRI viewer.");
+    args::HelpFlag help(parser, "help", "Display this help menu", {'h', "help"});
+    args::ValueFlag<int> gridSizeArg(parser, "grid size",
+                                     "Number of voxels along each axis of the synthetic volumes. Default: 64.",
+                                     {"grid"});
+    args::ValueFlag<int> nbCoeffsArg(parser, "SH coefficients",
+                                     "Number of SH coefficients. Default: 45.",
+                                     {"sh_coeffs"});
+    args::ValueFlag<int> resolutionArg(parser, "sphere resolution",
+                                       "Sphere resolution. Default: 3.",
+                                       {'s', "sphere_resolution"});
+    args::ValueFlag<int> repeatsArg(parser, "repeats",
+                                    "Number of runs per kernel, the best is kept. Default: 5.",
+                                    {"repeats"});
+    args::ValueFlag<unsigned int> threadsArg(parser, "threads",
+                                             "Maximum number of threads. Default: hardware concurrency.",
+                                             {"threads"});
+    try
+    {
+        parser.ParseCLI(argc, argv);
+    }
+    catch (const args::Help&)
+    {
+        std::cout << parser;
+        return 0;
+    }
+    catch (const args::ParseError& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << parser;
+        return -1;
+    }
+
+    const int gridSize = gridSizeArg ? args::get(gridSizeArg) : DEFAULT_GRID_SIZE;
+    const int nbCoeffs = nbCoeffsArg ? args::get(nbCoeffsArg) : DEFAULT_NB_SH_COEFFS;
+    const int resolution = resolutionArg ? args::get(resolutionArg) : DEFAULT_SPHERE_RESOLUTION;
+    const int nbRepeats = std::max(1, repeatsArg ? args::get(repeatsArg) : DEFAULT_NB_REPEATS);
+    const unsigned int maxThreads = std::max(1u, threadsArg ? args::get(threadsArg)
+                                                            : std::thread::hardware_concurrency());
+    const size_t nbVoxels = static_cast<size_t>(gridSize) * gridSize * gridSize;
+    const std::vector<unsigned int> threadCounts = getThreadCounts(maxThreads);
+    std::vector<Result> results;
+
+    // NiftiImageWrapper::copyImageVoxels, through the constructor.
+    {
+        const std::string path = (std::filesystem::temp_directory_path()
+                                / "dmriexplorer_bench.nii").string();
+        writeSyntheticImage(path, gridSize, nbCoeffs);
+        const double seconds = timeBest(nbRepeats, [&path]()
+        {
+            Slicer::NiftiImageWrapper<float> image(path);
+        });
+        results.push_back({"nifti_copy_voxels", 1, nbVoxels * nbCoeffs, seconds});
+        std::remove(path.c_str());
+    }
+
+    // DescoteauxBasis table generation, one row per sphere direction.
+    {
+        const Slicer::Primitive::Sphere sphere(resolution, nbCoeffs);
+        const std::vector<glm::vec4> points = sphere.GetPoints();
+        const Slicer::SH::DescoteauxBasis basis(nbCoeffs);
+        for(const unsigned int nbThreads : threadCounts)
+        {
+            Slicer::Utilities::ThreadPool pool(nbThreads);
+            std::vector<float> table(points.size() * nbCoeffs);
+            const double seconds = timeBest(nbRepeats, [&]()
+            {
+                pool.ParallelFor(points.size(), [&](unsigned int, size_t first, size_t last)
+                {
+                    for(size_t i = first; i < last; ++i)
+                    {
+                        const glm::vec3 p = glm::vec3(points[i]);
+                        const float theta = std::acos(std::clamp(p.z, -1.0f, 1.0f));
+                        const float phi = std::atan2(p.y, p.x);
+                        const std::vector<float> row = basis.at(theta, phi);
+                        std::copy(row.begin(), row.end(), table.begin() + i * nbCoeffs);
+                    }
+                });
+            });
+            results.push_back({"descoteaux_basis", nbThreads, points.size(), seconds});
+        }
+    }
+
+    // Sphere::subdivide, through the sphere construction.
+    {
+        size_t nbPoints = 0;
+        const double seconds = timeBest(nbRepeats, [&]()
+        {
+            const Slicer::Primitive::Sphere sphere(resolution, nbCoeffs);
+            nbPoints = sphere.GetPoints().size();
+        });
+        results.push_back({"sphere_subdivide", 1, nbPoints, seconds});
+    }
+
+    // getTensorFromCoefficients, eigenvalues and eigenvectors, per voxel.
+    {
+        std::vector<float> coefficients(nbVoxels * NB_TENSOR_COEFFS);
+        std::mt19937 generator(RANDOM_SEED);
+        std::uniform_real_distribution<float> diagonal(0.5f, 2.0f);
+        std::uniform_real_distribution<float> offDiagonal(-0.2f, 0.2f);
+        for(size_t v = 0; v < nbVoxels; ++v)
+        {
+            for(int c = 0; c < NB_TENSOR_COEFFS; ++c)
+            {
+                coefficients[v * NB_TENSOR_COEFFS + c] = c < 3 ? diagonal(generator)
+                                                               : offDiagonal(generator);
+            }
+        }
+        for(const unsigned int nbThreads : threadCounts)
+        {
+            Slicer::Utilities::ThreadPool pool(nbThreads);
+            std::vector<glm::vec3> lambdas(nbVoxels);
+            std::vector<glm::vec3> mainDirections(nbVoxels);
+            const double seconds = timeBest(nbRepeats, [&]()
+            {
+                pool.ParallelFor(nbVoxels, [&](unsigned int, size_t first, size_t last)
+                {
+                    for(size_t v = first; v < last; ++v)
+                    {
+                        const glm::mat4 tensor = getTensorFromCoefficients(
+                            coefficients, v * NB_TENSOR_COEFFS, "mrtrix");
+                        lambdas[v] = eigenvalues(glm::mat3(tensor));
+                        mainDirections[v] = std::get<0>(eigenvectors(glm::mat3(tensor)));
+                    }
+                });
+            });
+            results.push_back({"tensor_eigen", nbThreads, nbVoxels, seconds});
+        }
+    }
+
+    // normalize, on one scalar map.
+    {
+        std::vector<float> values(nbVoxels);
+        std::mt19937 generator(RANDOM_SEED);
+        std::uniform_real_distribution<float> distribution(0.0f, 3.0f);
+        for(auto& value : values)
+        {
+            value = distribution(generator);
+        }
+        const double seconds = timeBest(nbRepeats, [&]()
+        {
+            std::vector<float> copy = values;
+            normalize(copy);
+        });
+        results.push_back({"normalize", 1, nbVoxels, seconds});
+    }
+
+    // SHField::buildSphere draw commands, for the spheres of the three slices.
+    {
+        const Slicer::Primitive::Sphere sphere(resolution, nbCoeffs);
+        const std::vector<GLuint> sphereIndices = sphere.GetIndices();
+        const size_t nbSphereVertices = sphere.GetPoints().size();
+        const size_t nbSpheres = 3 * static_cast<size_t>(gridSize) * gridSize;
+        for(const unsigned int nbThreads : threadCounts)
+        {
+            Slicer::Utilities::ThreadPool pool(nbThreads);
+            std::vector<Slicer::DrawElementsIndirectCommand> commands(nbSpheres);
+            const double seconds = timeBest(nbRepeats, [&]()
+            {
+                pool.ParallelFor(nbSpheres, [&](unsigned int, size_t first, size_t last)
+                {
+                    Slicer::SHField::FillDrawCommands(static_cast<unsigned int>(sphereIndices.size()), 0,
+                                                      nbSphereVertices, first, last, commands);
+                });
+            });
+            results.push_back({"draw_commands", nbThreads, nbSpheres, seconds});
+        }
+    }
+
+    // SH coefficients of the middle slice along each axis, read in the
+    // linear and bricked layouts, as by the deformation of a slice.
+    {
+        using Image = Slicer::NiftiImageWrapper<float>;
+        const glm::ivec3 dims(gridSize);
+        const glm::ivec3 nbBricks = (dims + Image::BRICK_SIZE - 1) / Image::BRICK_SIZE;
+        const size_t nbBrickedVoxels = static_cast<size_t>(nbBricks.x) * nbBricks.y * nbBricks.z
+                                     * Image::BRICK_SIZE * Image::BRICK_SIZE * Image::BRICK_SIZE;
+        std::vector<float> coefficients(std::max(nbVoxels, nbBrickedVoxels) * nbCoeffs);
+        std::mt19937 generator(RANDOM_SEED);
+        std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+        for(auto& coefficient : coefficients)
+        {
+            coefficient = distribution(generator);
+        }
+
+        const char* axisNames[3] = {"x", "y", "z"};
+        const size_t nbSliceVoxels = static_cast<size_t>(gridSize) * gridSize;
+        for(const bool isBricked : {false, true})
+        {
+            for(int axis = 0; axis < 3; ++axis)
+            {
+                float sum = 0.0f;
+                const double seconds = timeBest(nbRepeats, [&]()
+                {
+                    for(int v = 0; v < gridSize; ++v)
+                    {
+                        for(int u = 0; u < gridSize; ++u)
+                        {
+                            glm::ivec3 index;
+                            index[axis] = gridSize / 2;
+                            index[(axis + 1) % 3] = u;
+                            index[(axis + 2) % 3] = v;
+                            const size_t voxel = isBricked
+                                ? Image::GetBrickedVoxelIndex(index, dims)
+                                : (static_cast<size_t>(index.z) * dims.y + index.y) * dims.x + index.x;
+                            for(int c = 0; c < nbCoeffs; ++c)
+                            {
+                                sum += coefficients[voxel * nbCoeffs + c];
+                            }
+                        }
+                    }
+                });
+                // Keep the reads from being optimized away.
+                if(sum == std::numeric_limits<float>::max())
+                {
+                    std::cerr << sum << std::endl;
+                }
+                results.push_back({std::string("sh_slice_") + (isBricked ? "bricked_" : "linear_") + axisNames[axis],
+                                   1, nbSliceVoxels * nbCoeffs, seconds});
+            }
+        }
+    }
+
+    // Machine-readable report.
+    std::cout << "{\n";
+    std::cout << "  \"grid\": " << gridSize << ",\n";
+    std::cout << "  \"sh_coeffs\": " << nbCoeffs << ",\n";
+    std::cout << "  \"sphere_resolution\": " << resolution << ",\n";
+    std::cout << "  \"repeats\": " << nbRepeats << ",\n";
+    std::cout << "  \"results\": [";
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& r = results[i];
+        std::cout << (i == 0 ? "\n" : ",\n")
+                  << "    {\"kernel\": \"" << r.Kernel << "\", \"threads\": " << r.NbThreads
+                  << ", \"items\": " << r.NbItems << ", \"seconds\": " << r.Seconds
+                  << ", \"items_per_second\": " << r.NbItems / r.Seconds << "}";
+    }
+    std::cout << "\n  ]\n";
+    std::cout << "}" << std::endl;
+    return 0;
+}
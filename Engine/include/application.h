@@ -4,11 +4,16 @@
 #include <GLFW/glfw3.h>
 #include <glm/common.hpp>
 #include <memory>
+#include <chrono>
+#include <future>
+#include <vector>
 #include <gui.h>
 #include <scene.h>
 #include <argument_parser.h>
 #include <camera.h>
+#include <framebuffer.h>
 #include <application_state.h>
+#include <thread_pool.h>
 
 namespace Slicer
 {
@@ -28,9 +33,18 @@ public:
     ~Application();
 
     /// Run the application. Handle inputs, render scene and UI.
+    ///
+    /// In benchmark mode, run the benchmark script and return.
     void Run();
 
 private:
+    /// Load the scene, run the benchmark script and write its results.
+    void runBenchmark();
+
+    /// Record a startup event, printed and reported by benchmarks.
+    /// \param[in] name Name of the event.
+    void recordStartupEvent(const std::string& name);
+
     /// Initialize GLFW, OpenGL backend, Scene, UI, Camera, etc.
     void initialize();
 
@@ -45,10 +59,41 @@ private:
     /// Render a frame one time.
     void renderFrame();
 
+    /// Request frames to be rendered, even in on-demand mode.
+    void requestRedraw();
+
+    /// Is there nothing to render?
+    /// \return True if no frame needs to be rendered.
+    bool isIdle() const;
+
+    /// Sleep to respect the maximum frame rate, if any.
+    void limitFrameRate();
+
+    /// Callback for vertical synchronization update.
+    /// \param[in] previous Previous value.
+    /// \param[in] vsync New value.
+    void setVSync(bool previous, bool vsync);
+
     /// Initialize the ApplicationState object.
+    ///
+    /// Images are loaded on worker threads, see pollStartupTasks().
     /// \param[in] parser The command line arguments.
     void initApplicationState(const ArgumentParser& parser);
 
+    /// \brief Complete the startup tasks whose images are loaded.
+    ///
+    /// Store the loaded images in the ApplicationState and add their
+    /// models to the scene, in the order the models are drawn.
+    /// \return True if a model was added.
+    bool pollStartupTasks();
+
+    /// Are images still being loaded or models still to be added?
+    /// \return True if startup is not completed.
+    bool isLoading() const;
+
+    /// Update the loading progress after a startup task is completed.
+    void completeStartupTask();
+
     /// Set the window icon.
     void setWindowIcon();
 
@@ -85,6 +130,10 @@ private:
     /// \param[in] mods The modifier bits.
     static void onPressSpace(GLFWwindow* window, int key, int scancode, int action, int mods);
 
+    /// GLFW callback for window content damage (e.g. uncovered window).
+    /// \param[in] window The current GLFW window.
+    static void onWindowRefresh(GLFWwindow* window);
+
     /// Pointer to application main window.
     GLFWwindow* mWindow;
 
@@ -109,6 +158,9 @@ private:
     /// Pointer to the secondary Camera.
     std::shared_ptr<Camera> mSecondaryCamera;
 
+    /// Offscreen framebuffer caching the secondary viewport.
+    std::shared_ptr<GPU::Framebuffer> mSecondaryFramebuffer;
+
     /// Pointer to the UI manager.
     std::shared_ptr<UIManager> mUI;
 
@@ -121,5 +173,50 @@ private:
     /// Parameters for control transfer between the viewports.
     /// For mouse clic detection.
     bool mClicSecondaryViewport;
+
+    /// Must the secondary viewport be rendered again?
+    bool mIsSecondaryViewDirty;
+
+    /// Number of frames left to render before going idle.
+    int mFramesToRender;
+
+    /// End time of the last rendered frame.
+    std::chrono::steady_clock::time_point mLastFrameTime;
+
+    /// Time at which the application was launched.
+    std::chrono::steady_clock::time_point mStartTime;
+
+    /// Worker threads reading and decoding the images.
+    std::unique_ptr<Utilities::ThreadPool> mLoadingPool;
+
+    /// Pending fODF image load.
+    std::future<NiftiImageWrapper<float>> mFODFImageLoad;
+
+    /// Pending tensor image loads, one per tensor image.
+    std::vector<std::future<NiftiImageWrapper<float>>> mTensorImageLoads;
+
+    /// Pending background image load.
+    std::future<NiftiImageWrapper<float>> mBackgroundImageLoad;
+
+    /// Number of startup tasks (image loads and model creations).
+    int mNbStartupTasks;
+
+    /// Number of completed startup tasks.
+    int mNbCompletedStartupTasks;
+
+    /// Is the MTField still to be added to the scene?
+    bool mIsMTFieldPending;
+
+    /// Is the SHField still to be added to the scene?
+    bool mIsSHFieldPending;
+
+    /// Is the Texture still to be added to the scene?
+    bool mIsTexturePending;
+
+    /// Path to the benchmark results, empty if not benchmarking.
+    std::string mBenchmarkPath;
+
+    /// Startup events, in seconds since launch.
+    std::vector<std::pair<std::string, double>> mStartupEvents;
 };
 } // namespace Slicer
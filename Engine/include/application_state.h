@@ -3,10 +3,66 @@
 #include <functional>
 #include <glm/glm.hpp>
 #include <nii_volume.h>
+#include <thread_pool.h>
 #include <iostream>
 
 namespace Slicer
 {
+/// \brief Queue of deferred parameter notifications.
+///
+/// While deferred, ApplicationParameter::Update() stores the new value
+/// right away but postpones its callbacks until Flush() is called. A
+/// parameter updated several times between two flushes notifies its
+/// callbacks only once, with its value before the first update and its
+/// latest value.
+class ParameterUpdateQueue
+{
+public:
+    /// Default constructor.
+    ParameterUpdateQueue()
+    :mIsDeferred(false)
+    ,mPending()
+    {};
+
+    /// Enable or disable deferred notifications.
+    /// \param[in] deferred True to defer callbacks until Flush().
+    inline void SetDeferred(bool deferred) { mIsDeferred = deferred; };
+
+    /// Are notifications deferred?
+    /// \return True if notifications are deferred.
+    inline bool IsDeferred() const { return mIsDeferred; };
+
+    /// Enqueue a deferred notification.
+    /// \param[in] notify Function calling the callbacks of a parameter.
+    inline void Push(const std::function<void()>& notify) { mPending.push_back(notify); };
+
+    /// Call all pending notifications, in the order of their first update.
+    /// Notifications pushed by callbacks during the flush are also called.
+    /// \return True if at least one notification was called.
+    bool Flush()
+    {
+        bool hasFlushed = false;
+        while(!mPending.empty())
+        {
+            std::vector<std::function<void()>> pending;
+            pending.swap(mPending);
+            for(const auto& notify : pending)
+            {
+                notify();
+            }
+            hasFlushed = true;
+        }
+        return hasFlushed;
+    };
+
+private:
+    /// Are notifications deferred?
+    bool mIsDeferred;
+
+    /// Pending notifications.
+    std::vector<std::function<void()>> mPending;
+};
+
 /// \brief An application parameter.
 ///
 /// Callbacks can be registered to this parameter. They will be
@@ -20,6 +76,9 @@ public:
     :mValue()
     ,mCallbacks()
     ,mIsInit(false)
+    ,mQueue(nullptr)
+    ,mPendingOld()
+    ,mHasPendingChange(false)
     {};
 
     /// Constructor.
@@ -28,6 +87,9 @@ public:
     :mValue(value)
     ,mCallbacks()
     ,mIsInit(true)
+    ,mQueue(nullptr)
+    ,mPendingOld()
+    ,mHasPendingChange(false)
     {};
 
     /// Register a callback.
@@ -41,7 +103,18 @@ public:
         mCallbacks.push_back(callback);
     };
 
+    /// Attach the parameter to an update queue.
+    /// \param[in] queue Queue deferring the callbacks of the parameter.
+    ///                  Must outlive the parameter.
+    void AttachQueue(ParameterUpdateQueue* queue)
+    {
+        mQueue = queue;
+    };
+
     /// Update the value associated with the parameter and call callbacks.
+    ///
+    /// When the attached queue is deferred, callbacks are called on the
+    /// next ParameterUpdateQueue::Flush() instead.
     /// \param[in] value Updated value.
     void Update(const T& value)
     {
@@ -49,6 +122,17 @@ public:
         {
             mIsInit = true;
         }
+        if(mQueue != nullptr && mQueue->IsDeferred())
+        {
+            if(!mHasPendingChange)
+            {
+                mPendingOld = mValue;
+                mHasPendingChange = true;
+                mQueue->Push([this]() { this->notifyPending(); });
+            }
+            mValue = value;
+            return;
+        }
         const T vOld = mValue;
         mValue = value;
         onChange(vOld);
@@ -56,7 +140,17 @@ public:
 
     /// Get the value contained in parameter instance.
     /// \return The value.
-    T Get() const
+    const T& Get() const
+    {
+        if(!mIsInit)
+            std::cout << "WARNING: Accessing non-initialized parameter!" << std::endl;
+        return mValue;
+    };
+
+    /// Get the value contained in parameter instance, to change it in
+    /// place. Callbacks are not called.
+    /// \return The value.
+    T& GetMutable()
     {
         if(!mIsInit)
             std::cout << "WARNING: Accessing non-initialized parameter!" << std::endl;
@@ -72,12 +166,20 @@ private:
     /// \param[in] old Previous value associated to the parameter.
     void onChange(const T& old) const
     {
-        for(auto cb : mCallbacks)
+        for(const auto& cb : mCallbacks)
         {
             cb(old, mValue);
         }
     };
 
+    /// Call callbacks for the changes accumulated while deferred.
+    void notifyPending()
+    {
+        mHasPendingChange = false;
+        const T vOld = mPendingOld;
+        onChange(vOld);
+    };
+
     /// Is the value initialized?
     bool mIsInit;
 
@@ -86,6 +188,15 @@ private:
 
     /// Callbacks to call when updating the value of this object.
     std::vector<std::function<void(T, T)>> mCallbacks;
+
+    /// Queue deferring the callbacks, if any.
+    ParameterUpdateQueue* mQueue;
+
+    /// Value before the first deferred update.
+    T mPendingOld;
+
+    /// Is a deferred notification pending?
+    bool mHasPendingChange;
 };
 
 namespace State
@@ -161,7 +272,10 @@ struct Window
     ,Height()
     ,TranslationSpeed()
     ,RotationSpeed()
-    ,ZoomSpeed(){};
+    ,ZoomSpeed()
+    ,ContinuousRendering()
+    ,MaxFPS()
+    ,VSync(){};
 
     /// Window width in pixels
     ApplicationParameter<int> Width;
@@ -180,6 +294,15 @@ struct Window
 
     /// Multiplier on mouse wheel movement to control camera zoom speed.
     ApplicationParameter<float> ZoomSpeed;
+
+    /// Render frames even when nothing changes.
+    ApplicationParameter<bool> ContinuousRendering;
+
+    /// Maximum number of frames per second, 0 for no limit.
+    ApplicationParameter<int> MaxFPS;
+
+    /// Synchronize buffer swaps with the display refresh rate.
+    ApplicationParameter<bool> VSync;
 };
 
 ///Struct containing parameters for the 2D view mode
@@ -201,6 +324,12 @@ public:
     /// Default constructor
     ApplicationState();
 
+    /// Copy constructor (deleted). Parameters refer to UpdateQueue.
+    ApplicationState(const ApplicationState&) = delete;
+
+    /// Queue deferring the callbacks of interactive parameters.
+    ParameterUpdateQueue UpdateQueue;
+
     /// Parameters pertaining to the voxel grid.
     State::Grid VoxelGrid;
 
@@ -225,7 +354,32 @@ public:
     /// Parameter for MagnifyingMode mode control.
     ApplicationParameter<bool> MagnifyingMode;
     
-    /// Parameter containing the fODF image object.
+    /// Parameter containing the background image object. Its voxels
+    /// are released once uploaded to the GPU, unless streaming.
     ApplicationParameter<NiftiImageWrapper<float>> BackgroundImage;
+
+    /// Parameter for background streaming mode. When true, only the
+    /// three slices of interest of the background image live on the GPU.
+    ApplicationParameter<bool> StreamBackground;
+
+    /// Parameter for the budget of the GPU cache of SH coefficients, in
+    /// MiB. When 0, the whole fODF image lives on the GPU.
+    ApplicationParameter<int> SHCacheSize;
+
+    /// Parameter for the number of components of the low-rank basis the
+    /// SH coefficients are compressed to. When 0, they are not compressed.
+    ApplicationParameter<int> SHRank;
+
+    /// Parameter disabling shader specialization. When true, the rendering
+    /// options are read at runtime by a single generic shader.
+    ApplicationParameter<bool> GenericShaders;
+
+    /// Fraction of the startup work completed, between 0 and 1.
+    ApplicationParameter<float> LoadingProgress;
+
+    /// Worker threads of the CPU passes over the loaded images, one per
+    /// hardware thread. The image loads run on their own pool, a pass
+    /// never waits behind a load.
+    std::shared_ptr<Utilities::ThreadPool> WorkerPool;
 };
 } // namespace Slicer
\ No newline at end of file
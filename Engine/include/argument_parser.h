@@ -40,7 +40,51 @@ public:
     /// \return Tensor coefficient format string.
     inline std::string GetTensorFormat() const { return mTensorFormat; };
 
+    /// Background streaming mode getter.
+    /// \return True if the background image is streamed slice by slice.
+    inline bool GetStreamBackground() const { return mStreamBackground; };
+
+    /// SH coefficients layout getter.
+    /// \return True if the fODF image is reordered by bricks at load.
+    inline bool GetBrickedSHLayout() const { return mBrickedSHLayout; };
+
+    /// SH coefficients cache budget getter.
+    /// \return Budget of the GPU cache of SH coefficients in MiB, 0 if disabled.
+    inline int GetSHCacheSize() const { return mSHCacheSize; };
+
+    /// SH coefficients compression rank getter.
+    /// \return Number of components of the low-rank basis, 0 if disabled.
+    inline int GetSHRank() const { return mSHRank; };
+
+    /// Continuous rendering getter.
+    /// \return True if frames are rendered even when nothing changes.
+    inline bool GetContinuousRendering() const { return mContinuousRendering; };
+
+    /// Maximum frame rate getter.
+    /// \return Maximum number of frames per second, 0 for no limit.
+    inline int GetMaxFPS() const { return mMaxFPS; };
+
+    /// Vertical synchronization getter.
+    /// \return True if buffer swaps are synchronized with the display.
+    inline bool GetVSync() const { return mVSync; };
+
+    /// Generic shaders getter.
+    /// \return True if shader specialization is disabled.
+    inline bool GetGenericShaders() const { return mGenericShaders; };
+
+    /// Benchmark output path getter.
+    /// \return Path to the benchmark results, empty if not benchmarking.
+    inline std::string GetBenchmarkPath() const { return mBenchmarkPath; };
+
 private:
+    /// \brief Check that the fODF and tensor images share the same voxel grid.
+    ///
+    /// Only the image headers are read, mismatches are reported before
+    /// any voxel data is decoded. The background image can have any size.
+    /// \return True if all images exist and the fODF and tensor images
+    ///         have the same dimensions.
+    bool validateImageDimensions() const;
+
     /// Path to the fodf image.
     std::string mImagePath;
 
@@ -56,6 +100,35 @@ private:
     /// Tensor coefficients ordering mode
     std::string mTensorFormat;
 
+    /// Stream the background image slice by slice instead of
+    /// uploading the whole volume to the GPU.
+    bool mStreamBackground;
+
+    /// Reorder the fODF image by bricks instead of x-fastest order.
+    bool mBrickedSHLayout;
+
+    /// Budget of the GPU cache of SH coefficients in MiB, 0 if disabled.
+    int mSHCacheSize;
+
+    /// Number of components of the low-rank basis of the SH
+    /// coefficients, 0 if disabled.
+    int mSHRank;
+
+    /// Render frames even when nothing changes.
+    bool mContinuousRendering;
+
+    /// Maximum number of frames per second, 0 for no limit.
+    int mMaxFPS;
+
+    /// Synchronize buffer swaps with the display.
+    bool mVSync;
+
+    /// Use generic shaders instead of specialized variants.
+    bool mGenericShaders;
+
+    /// Path to the benchmark results, empty if not benchmarking.
+    std::string mBenchmarkPath;
+
     /// Are all arguments valid?
     bool mIsValid;
 };
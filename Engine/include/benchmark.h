@@ -0,0 +1,93 @@
+#pragma once
+#include <glad/glad.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <camera.h>
+#include <application_state.h>
+
+namespace Slicer
+{
+/// \brief Scripted benchmark run by the application in benchmark mode.
+///
+/// The script orbits the camera, sweeps each slice axis, cycles the
+/// view modes and exercises the magnifier. Every scripted frame is
+/// timed on the CPU and with a GL_TIME_ELAPSED query on the GPU.
+/// Queries are only read back by WriteResults(), so the benchmark
+/// never waits on the GPU while frames are rendered.
+class Benchmark
+{
+public:
+    /// Default constructor (deleted).
+    Benchmark() = delete;
+
+    /// Constructor. The voxel grid must be initialized.
+    /// \param[in] state Reference to the ApplicationState.
+    Benchmark(const std::shared_ptr<ApplicationState>& state);
+
+    /// Destructor.
+    ~Benchmark();
+
+    /// Number of scripted frames.
+    /// \return The number of frames.
+    inline size_t GetNbFrames() const { return mSteps.size(); };
+
+    /// Apply the scripted changes for a frame.
+    /// \param[in] frame Index of the frame.
+    /// \param[in] camera Main camera.
+    /// \param[in] secondaryCamera Magnifier camera.
+    /// \return True if the magnifier view changed.
+    bool PrepareFrame(size_t frame, Camera& camera, Camera& secondaryCamera);
+
+    /// Start timing the current frame.
+    void BeginFrame();
+
+    /// Stop timing the current frame.
+    void EndFrame();
+
+    /// Write the results to a JSON file.
+    /// \param[in] path Path to the output file.
+    /// \param[in] startupEvents Startup events, by name, in seconds since launch.
+    /// \return True if the file was written.
+    bool WriteResults(const std::string& path,
+                      const std::vector<std::pair<std::string, double>>& startupEvents);
+
+private:
+    /// A scripted frame.
+    struct Step
+    {
+        /// Name of the phase the frame belongs to.
+        std::string Phase;
+
+        /// Changes applied before the frame, returning true if the
+        /// magnifier view changed.
+        std::function<bool(Camera&, Camera&)> Apply;
+    };
+
+    /// Append frames to the script.
+    /// \param[in] phase Name of the phase.
+    /// \param[in] nbFrames Number of frames.
+    /// \param[in] apply Changes applied before each frame, given the
+    ///                  index of the frame in the phase.
+    void addPhase(const std::string& phase, size_t nbFrames,
+                  const std::function<bool(size_t, Camera&, Camera&)>& apply);
+
+    /// Reference to the ApplicationState.
+    std::shared_ptr<ApplicationState> mState;
+
+    /// Scripted frames.
+    std::vector<Step> mSteps;
+
+    /// GL_TIME_ELAPSED queries, one per frame.
+    std::vector<GLuint> mQueries;
+
+    /// CPU time of each frame, in milliseconds.
+    std::vector<double> mCPUTimes;
+
+    /// CPU start time of the current frame.
+    std::chrono::steady_clock::time_point mFrameStart;
+};
+} // namespace Slicer
@@ -27,6 +27,16 @@ enum class Binding
     mdValues = 17,
     adValues = 18,
     rdValues = 19,
+    deformationInfo = 20,
+    previousRadiis = 21,
+    tileList = 22,
+    tileValidity = 23,
+    previousSpheresNormals = 24,
+    previousMaxAmplitude = 25,
+    drawCommands = 26,
+    lodLevels = 27,
+    lodInfo = 28,
+    brickPageTable = 29,
     none = 30
 };
 } // namespace GPU
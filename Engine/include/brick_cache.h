@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <list>
+#include <vector>
+#include <binding.h>
+#include <shader_data.h>
+
+namespace Slicer
+{
+namespace GPU
+{
+/// \brief GPU cache of the bricks of a volume, with LRU eviction.
+///
+/// The volume stays in host memory, ordered by bricks. A pool of a fixed
+/// number of slots holds the resident bricks on the GPU, and a page table
+/// gives the slot of each brick. Shaders read a value through the page
+/// table, the bricks they read must be made resident first. Must only be
+/// used from the OpenGL thread.
+class BrickCache
+{
+public:
+    /// Value of the page table for bricks that are not resident.
+    static constexpr GLuint INVALID_SLOT = 0xFFFFFFFF;
+
+    /// Default constructor.
+    BrickCache();
+
+    /// Constructor. No brick is resident.
+    /// \param[in] data Values of the volume, one brick after the other.
+    ///                 Must outlive the cache.
+    /// \param[in] nbValuesPerBrick Number of values of a brick.
+    /// \param[in] nbBricks Number of bricks of the volume.
+    /// \param[in] nbSlots Number of bricks of the pool.
+    /// \param[in] poolBinding GPU binding of the pool.
+    /// \param[in] pageTableBinding GPU binding of the page table.
+    BrickCache(const float* data, size_t nbValuesPerBrick, GLuint nbBricks,
+               GLuint nbSlots, Binding poolBinding, Binding pageTableBinding);
+
+    /// \brief Make bricks resident.
+    ///
+    /// Missing bricks are uploaded to the least recently used slots.
+    /// The bricks of a call are never evicted by the same call.
+    /// \param[in] bricks Indices of the bricks, duplicates are allowed.
+    /// \throw std::runtime_error if the pool has fewer slots than bricks.
+    void MakeResident(const std::vector<GLuint>& bricks);
+
+    /// Bind the pool and the page table to their bindings.
+    void Bind();
+
+    /// Get the number of slots of the pool.
+    /// \return Number of bricks the pool can hold.
+    inline GLuint GetNbSlots() const { return static_cast<GLuint>(mSlotBricks.size()); };
+
+private:
+    /// Values of the volume, by bricks.
+    const float* mData;
+
+    /// Number of values of a brick.
+    size_t mNbValuesPerBrick;
+
+    /// Slot of each brick, INVALID_SLOT if not resident.
+    std::vector<GLuint> mPageTable;
+
+    /// Brick of each slot, INVALID_SLOT if free.
+    std::vector<GLuint> mSlotBricks;
+
+    /// Slots from the least to the most recently used.
+    std::list<GLuint> mLeastRecentlyUsed;
+
+    /// Position of each slot in mLeastRecentlyUsed.
+    std::vector<std::list<GLuint>::iterator> mSlotPositions;
+
+    /// Number of calls to MakeResident().
+    size_t mNbRequests;
+
+    /// Last call to MakeResident() using each slot.
+    std::vector<size_t> mSlotLastRequest;
+
+    /// Pool of resident bricks GPU data.
+    ShaderData mPoolData;
+
+    /// Page table GPU data.
+    ShaderData mPageTableData;
+};
+} // namespace GPU
+} // namespace Slicer
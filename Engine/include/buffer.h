@@ -0,0 +1,156 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Slicer
+{
+namespace GPU
+{
+/// \brief Buffer object with immutable storage, deleted with the object.
+///
+/// Buffers can be moved but not copied, so that exactly one object
+/// owns each GL buffer name.
+class Buffer
+{
+public:
+    /// Default constructor. Owns no buffer.
+    Buffer();
+
+    /// Constructor. The buffer is not recorded in the memory registry.
+    /// \param[in] size Size of the buffer, in bytes.
+    /// \param[in] data Initial content, or nullptr.
+    /// \param[in] flags Storage flags given to glNamedBufferStorage.
+    Buffer(GLsizeiptr size, const void* data, GLbitfield flags);
+
+    /// Constructor. The buffer is recorded in the memory registry,
+    /// for the current owner.
+    /// \param[in] size Size of the buffer, in bytes.
+    /// \param[in] data Initial content, or nullptr.
+    /// \param[in] flags Storage flags given to glNamedBufferStorage.
+    /// \param[in] purpose Purpose of the buffer, for the memory registry.
+    Buffer(GLsizeiptr size, const void* data, GLbitfield flags, const std::string& purpose);
+
+    /// Move constructor.
+    /// \param[in] other Buffer to move.
+    Buffer(Buffer&& other) noexcept;
+
+    /// Move assignment operator. The current buffer is deleted.
+    /// \param[in] other Buffer to move.
+    /// \return Reference to this buffer.
+    Buffer& operator=(Buffer&& other) noexcept;
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    /// Destructor. Deletes the buffer.
+    ~Buffer();
+
+    /// Get the GL buffer name.
+    /// \return Buffer name, 0 if the object owns no buffer.
+    inline GLuint GetID() const { return mBuffer; };
+
+    /// Get the size of the buffer.
+    /// \return Size in bytes.
+    inline GLsizeiptr GetSize() const { return mSize; };
+
+private:
+    /// Delete the buffer, if any.
+    void release();
+
+    /// GL buffer name.
+    GLuint mBuffer;
+
+    /// Size in bytes.
+    GLsizeiptr mSize;
+
+    /// Identifier in the memory registry, 0 if not recorded.
+    size_t mMemoryId;
+};
+
+/// Range of a buffer allocated by the BufferArena.
+struct BufferRange
+{
+    /// GL buffer name, 0 for an empty range.
+    GLuint Buffer;
+
+    /// Offset in the buffer, in bytes.
+    GLintptr Offset;
+
+    /// Size requested for the range, in bytes.
+    GLsizeiptr Size;
+};
+
+/// \brief Sub-allocator of shader storage ranges.
+///
+/// Ranges are carved from large blocks of immutable storage, aligned
+/// for glBindBufferRange on GL_SHADER_STORAGE_BUFFER. Freed ranges are
+/// merged with their free neighbours and reused by later allocations.
+/// Allocations larger than a block get a dedicated block, deleted as
+/// soon as it is freed. Must only be used from the OpenGL thread.
+class BufferArena
+{
+public:
+    /// Get the arena of the application.
+    /// \return The arena instance.
+    static BufferArena& Instance();
+
+    /// Allocate a range. Its content can be updated with glNamedBufferSubData.
+    /// \param[in] size Size of the range, in bytes.
+    /// \return The allocated range.
+    BufferRange Allocate(GLsizeiptr size);
+
+    /// Free a range. Ranges of blocks deleted by Clear() are ignored.
+    /// \param[in] range Range to free.
+    void Free(const BufferRange& range);
+
+    /// Delete all blocks. Must be called while the OpenGL context is current.
+    void Clear();
+
+    /// Get the number of blocks.
+    /// \return Number of GL buffers owned by the arena.
+    inline size_t GetNbBlocks() const { return mBlocks.size(); };
+
+private:
+    /// Block of storage sub-allocated by the arena.
+    struct Block
+    {
+        /// Storage of the block.
+        GPU::Buffer Storage;
+
+        /// Free ranges, size by offset.
+        std::map<GLintptr, GLsizeiptr> FreeRanges;
+
+        /// Is the block dedicated to a single large allocation?
+        bool IsDedicated;
+    };
+
+    /// Constructor.
+    BufferArena();
+
+    /// Round a size up to the range alignment.
+    /// \param[in] size Size in bytes.
+    /// \return Aligned size in bytes.
+    GLsizeiptr getAlignedSize(GLsizeiptr size) const;
+
+    /// Update the free space recorded in the memory registry.
+    /// \param[in] delta Change of the free space, in bytes.
+    void updateFreeBytes(GLsizeiptr delta);
+
+    /// Blocks of the arena.
+    std::vector<std::unique_ptr<Block>> mBlocks;
+
+    /// Alignment of the ranges, in bytes. 0 until the first allocation.
+    GLsizeiptr mAlignment;
+
+    /// Free bytes over all blocks.
+    GLsizeiptr mNbFreeBytes;
+
+    /// Identifier of the free space in the memory registry.
+    size_t mFreeMemoryId;
+};
+} // namespace GPU
+} // namespace Slicer
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <glm/glm.hpp>
-#include <shader_data.h>
 #include <memory>
 #include <coordinate_system.h>
 #include <application_state.h>
@@ -58,6 +57,10 @@ public:
     /// Update camera attributes on the GPU.
     void UpdateGPU();
 
+    /// Get the transform from world coordinates to clip coordinates.
+    /// \return Product of the projection and view matrices.
+    inline glm::mat4 GetViewProjection() const { return mProjectionMatrix * mViewMatrix; };
+
 private:
     /// Set the state for the camera mode
     /// \param[in] previous Previous value.
@@ -104,9 +107,6 @@ private:
     /// Pointer to the ApplicationState, containing global parameters.
     std::shared_ptr<ApplicationState> mState;
 
-    /// Shader data for camera attributes.
-    GPU::ShaderData mCamParamsData;
-
     //Boolean to block the rotation of the scene
     bool mBlockRotation;
 };
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+
+namespace Slicer
+{
+namespace GPU
+{
+/// \brief Offscreen framebuffer with a color and a depth attachment.
+///
+/// Rendering can be redirected to the framebuffer and the result
+/// copied to the default framebuffer later, without drawing again.
+class Framebuffer
+{
+public:
+    /// Default constructor.
+    Framebuffer();
+
+    /// Constructor.
+    /// \param[in] width Width of the attachments in pixels.
+    /// \param[in] height Height of the attachments in pixels.
+    Framebuffer(int width, int height);
+
+    /// Copy constructor (deleted). The framebuffer owns GL objects.
+    Framebuffer(const Framebuffer&) = delete;
+
+    /// Copy assignment (deleted). The framebuffer owns GL objects.
+    Framebuffer& operator=(const Framebuffer&) = delete;
+
+    /// Destructor.
+    ~Framebuffer();
+
+    /// Resize the attachments. Does nothing if the size is unchanged.
+    /// \param[in] width New width in pixels.
+    /// \param[in] height New height in pixels.
+    /// \return True if the attachments were reallocated.
+    bool Resize(int width, int height);
+
+    /// Redirect rendering to the framebuffer.
+    void Bind() const;
+
+    /// Restore rendering to the default framebuffer.
+    static void Unbind();
+
+    /// Copy the color attachment to the default framebuffer.
+    /// \param[in] x Left position of the destination in pixels.
+    /// \param[in] y Bottom position of the destination in pixels.
+    /// \note Affected by the scissor test.
+    void BlitToDefault(int x, int y) const;
+
+    /// Get the width of the attachments.
+    /// \return Width in pixels.
+    inline int GetWidth() const { return mWidth; };
+
+    /// Get the height of the attachments.
+    /// \return Height in pixels.
+    inline int GetHeight() const { return mHeight; };
+
+private:
+    /// Create the attachments for the current size.
+    void createAttachments();
+
+    /// Delete the attachments.
+    void deleteAttachments();
+
+    /// Framebuffer object.
+    GLuint mFBO;
+
+    /// Color attachment texture.
+    GLuint mColorTexture;
+
+    /// Depth attachment renderbuffer.
+    GLuint mDepthRenderbuffer;
+
+    /// Width of the attachments.
+    int mWidth;
+
+    /// Height of the attachments.
+    int mHeight;
+
+    /// Owner of the attachments in the memory registry.
+    std::string mOwner;
+
+    /// Identifier of the attachments in the memory registry.
+    size_t mMemoryId;
+};
+} // namespace GPU
+} // namespace Slicer
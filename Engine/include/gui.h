@@ -55,6 +55,15 @@ private:
     /// Draw ImGUI demo window.
     void drawDemoWindow();
 
+    /// Draw the loading progress bar while images are loaded.
+    void drawLoadingWindow();
+
+    /// Draw the profiler window, with frame times and per pass times.
+    void drawProfilerWindow();
+
+    /// Draw the memory window, with the allocations of the memory registry.
+    void drawMemoryWindow();
+
     /// Pointer to GLFW window.
     GLFWwindow* mWindow;
 
@@ -81,5 +90,11 @@ private:
 
     /// True to show preferences window.
     bool mShowPreferences;
+
+    /// True to show profiler window. Profiling is enabled while shown.
+    bool mShowProfiler;
+
+    /// True to show memory window.
+    bool mShowMemory;
 };
 } // namespace Slicer
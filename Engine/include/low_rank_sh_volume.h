@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <nii_volume.h>
+#include <memory_registry.h>
+#include <thread_pool.h>
+
+namespace Slicer
+{
+/// \brief SH coefficients image compressed to a low-rank basis.
+///
+/// The first coefficient of each voxel is kept as is, it is read by the
+/// SH0 threshold. The other coefficients of the non-empty voxels are fitted
+/// with the principal components of their second moment matrix. Each voxel
+/// then stores its first coefficient followed by one weight per component.
+/// The fit and the projection run once, in parallel.
+class LowRankSHVolume
+{
+public:
+    /// Constructor.
+    /// \param[in] image SH coefficients image, in any voxel order.
+    /// \param[in] rank Number of components, clamped to the number of
+    ///                 coefficients after the first one.
+    /// \param[in] pool Worker threads running the compression.
+    LowRankSHVolume(const NiftiImageWrapper<float>& image, unsigned int rank,
+                    Utilities::ThreadPool& pool);
+
+    /// Get the compressed values.
+    /// \return First coefficient and weights of each voxel, in the voxel
+    ///         order of the image.
+    inline const std::vector<float>& GetValues() const { return mValues; };
+
+    /// Get the number of values per voxel.
+    /// \return One plus the number of components.
+    inline unsigned int GetNbValuesPerVoxel() const { return mRank + 1; };
+
+    /// Get the relative reconstruction error.
+    /// \return Norm of the residual over norm of the coefficients, over
+    ///         the non-empty voxels.
+    inline double GetRelativeError() const { return mRelativeError; };
+
+    /// Project SH functions on the components.
+    ///
+    /// The first column is kept, and column i is the sum of the SH
+    /// functions weighted by component i. Evaluating a voxel from its
+    /// compressed values is then a sum of GetNbValuesPerVoxel() terms.
+    /// \param[in] shFuncs SH functions, one row of coefficients per vertex.
+    /// \return Projected functions, one row of GetNbValuesPerVoxel() values
+    ///         per vertex.
+    std::vector<float> ProjectSHFunctions(const std::vector<float>& shFuncs) const;
+
+private:
+    /// Compute the components from the coefficients of the non-empty voxels.
+    /// \param[in] data SH coefficients.
+    /// \param[in] pool Worker threads.
+    void computeComponents(const std::vector<float>& data, Utilities::ThreadPool& pool);
+
+    /// Compute the compressed values and the reconstruction error.
+    /// \param[in] data SH coefficients.
+    /// \param[in] pool Worker threads.
+    void compress(const std::vector<float>& data, Utilities::ThreadPool& pool);
+
+    /// Number of SH coefficients of the image.
+    unsigned int mNbCoeffs;
+
+    /// Number of voxels of the image, including padding.
+    size_t mNbVoxels;
+
+    /// Number of components.
+    unsigned int mRank;
+
+    /// Components, one row of mNbCoeffs - 1 values per component, by
+    /// decreasing eigenvalue.
+    std::vector<float> mComponents;
+
+    /// First coefficient and weights of each voxel.
+    std::vector<float> mValues;
+
+    /// Relative reconstruction error.
+    double mRelativeError;
+
+    /// Host memory of mValues, in the memory registry.
+    Utilities::MemoryRecord mValuesMemory;
+};
+} // namespace Slicer
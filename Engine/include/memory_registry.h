@@ -0,0 +1,217 @@
+#pragma once
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Slicer
+{
+namespace Utilities
+{
+/// \brief Registry of the GPU and host memory allocated by the application.
+///
+/// Every GPU buffer, GPU texture and major host allocation is recorded
+/// with its owner, its purpose, its size and its lifetime. Allocations
+/// are attributed to the owner of the innermost MemoryOwner scope of the
+/// calling thread, unless an owner is given explicitly. Thread-safe.
+class MemoryRegistry
+{
+public:
+    /// Kinds of memory.
+    enum class Kind
+    {
+        gpuBuffer,
+        gpuTexture,
+        host
+    };
+
+    /// Recorded allocation.
+    struct Entry
+    {
+        /// Identifier of the allocation.
+        size_t Id;
+
+        /// Kind of memory.
+        Kind Type;
+
+        /// Owner of the allocation, e.g. a model.
+        std::string Owner;
+
+        /// Purpose of the allocation, e.g. a GPU binding.
+        std::string Purpose;
+
+        /// Size in bytes.
+        size_t Bytes;
+
+        /// Allocation time, in seconds since the registry creation.
+        double AllocationTime;
+
+        /// Release time, in seconds since the registry creation.
+        /// Negative while the allocation is alive.
+        double ReleaseTime;
+    };
+
+    /// Get the registry of the application.
+    /// \return The registry instance.
+    static MemoryRegistry& Instance();
+
+    /// Get the name of a kind of memory.
+    /// \param[in] kind Kind of memory.
+    /// \return Name of the kind.
+    static const char* ToString(Kind kind);
+
+    /// Record an allocation of the current owner.
+    /// \param[in] kind Kind of memory.
+    /// \param[in] purpose Purpose of the allocation.
+    /// \param[in] bytes Size in bytes.
+    /// \return Identifier of the allocation, never 0.
+    size_t Register(Kind kind, const std::string& purpose, size_t bytes);
+
+    /// Record an allocation.
+    /// \param[in] kind Kind of memory.
+    /// \param[in] owner Owner of the allocation.
+    /// \param[in] purpose Purpose of the allocation.
+    /// \param[in] bytes Size in bytes.
+    /// \return Identifier of the allocation, never 0.
+    size_t Register(Kind kind, const std::string& owner,
+                    const std::string& purpose, size_t bytes);
+
+    /// Update the size of an allocation.
+    /// \param[in] id Identifier of the allocation.
+    /// \param[in] bytes New size in bytes.
+    void Resize(size_t id, size_t bytes);
+
+    /// Record the release of an allocation. Unknown identifiers are ignored.
+    /// \param[in] id Identifier of the allocation.
+    void Release(size_t id);
+
+    /// Get the owner of the innermost MemoryOwner scope of the calling thread.
+    /// \return The current owner.
+    std::string GetCurrentOwner() const;
+
+    /// Get the allocations alive, largest first.
+    /// \return Allocations alive.
+    std::vector<Entry> GetLiveEntries() const;
+
+    /// Get the most recent released allocations, most recent first.
+    /// \return Released allocations.
+    std::vector<Entry> GetReleasedEntries() const;
+
+    /// Get the number of bytes alive.
+    /// \param[in] kind Kind of memory.
+    /// \return Number of bytes.
+    size_t GetTotalBytes(Kind kind) const;
+
+    /// Get the highest number of bytes alive at once.
+    /// \param[in] kind Kind of memory.
+    /// \return Number of bytes.
+    size_t GetPeakBytes(Kind kind) const;
+
+    /// Get the time elapsed since the registry creation.
+    /// \return Time in seconds.
+    double GetTime() const;
+
+private:
+    friend class MemoryOwner;
+
+    /// Constructor.
+    MemoryRegistry();
+
+    /// Open an owner scope on the calling thread.
+    /// \param[in] owner Owner of the allocations in the scope.
+    void pushOwner(const std::string& owner);
+
+    /// Close the innermost owner scope of the calling thread.
+    void popOwner();
+
+    /// Creation time of the registry.
+    std::chrono::steady_clock::time_point mStartTime;
+
+    /// Guards all the members below.
+    mutable std::mutex mMutex;
+
+    /// Next allocation identifier.
+    size_t mNextId;
+
+    /// Allocations alive, by identifier.
+    std::map<size_t, Entry> mLiveEntries;
+
+    /// Most recent released allocations, oldest first.
+    std::vector<Entry> mReleasedEntries;
+
+    /// Bytes alive, by kind.
+    std::map<Kind, size_t> mTotalBytes;
+
+    /// Highest bytes alive at once, by kind.
+    std::map<Kind, size_t> mPeakBytes;
+};
+
+/// \brief Scope attributing the allocations of the calling thread to an owner.
+///
+/// Scopes may be nested, the innermost owner is used.
+class MemoryOwner
+{
+public:
+    /// Constructor.
+    /// \param[in] owner Owner of the allocations in the scope.
+    MemoryOwner(const std::string& owner);
+
+    /// Destructor.
+    ~MemoryOwner();
+
+    MemoryOwner(const MemoryOwner&) = delete;
+    MemoryOwner& operator=(const MemoryOwner&) = delete;
+};
+
+/// \brief Host allocation recorded in the registry for the lifetime of the object.
+///
+/// Meant to be a member of the object holding the memory. Copies record
+/// a new allocation of the same size, moves transfer the record.
+class MemoryRecord
+{
+public:
+    /// Default constructor. Records nothing.
+    MemoryRecord();
+
+    /// Constructor.
+    /// \param[in] owner Owner of the allocation.
+    /// \param[in] purpose Purpose of the allocation.
+    /// \param[in] bytes Size in bytes.
+    MemoryRecord(const std::string& owner, const std::string& purpose, size_t bytes);
+
+    /// Copy constructor.
+    /// \param[in] other Record to copy.
+    MemoryRecord(const MemoryRecord& other);
+
+    /// Move constructor.
+    /// \param[in] other Record to move.
+    MemoryRecord(MemoryRecord&& other) noexcept;
+
+    /// Destructor.
+    ~MemoryRecord();
+
+    /// Assignment operator.
+    /// \param[in] other Record to copy or move.
+    /// \return Reference to this record.
+    MemoryRecord& operator=(MemoryRecord other) noexcept;
+
+    /// Update the size of the allocation.
+    /// \param[in] bytes New size in bytes.
+    void Resize(size_t bytes);
+
+private:
+    /// Identifier in the registry, 0 if nothing is recorded.
+    size_t mId;
+
+    /// Owner of the allocation.
+    std::string mOwner;
+
+    /// Purpose of the allocation.
+    std::string mPurpose;
+
+    /// Size in bytes.
+    size_t mBytes;
+};
+} // namespace Utilities
+} // namespace Slicer
@@ -2,6 +2,7 @@
 #include <glm/matrix.hpp>
 #include <coordinate_system.h>
 #include <memory>
+#include <string>
 #include <shader_data.h>
 #include <shader.h>
 #include <application_state.h>
@@ -26,7 +27,17 @@ public:
     ~Model();
 
     /// Draw the object.
-    void Draw();
+    /// \param[in] viewProjection Transform from world coordinates to the
+    ///                           clip coordinates of the camera.
+    void Draw(const glm::mat4& viewProjection);
+
+    /// Does the model need more frames to complete its updates?
+    /// \return True if asynchronous work is still in flight.
+    virtual bool HasPendingUpdates() const { return false; };
+
+    /// Get the name of the model, as displayed by the profiler.
+    /// \return The name of the model.
+    virtual std::string GetName() const = 0;
 
 protected:
     /// Initialize the model.
@@ -65,14 +76,15 @@ protected:
     /// Reference to the ApplicationState.
     std::shared_ptr<ApplicationState> mState;
 
+    /// Transform from the model coordinate system to the clip
+    /// coordinates of the camera, for the current draw.
+    glm::mat4 mModelViewProjection;
+
 private:
     /// Upload the model transform from its coordinate system to World
     /// coordinate system to the GPU.
     void uploadTransformToGPU();
 
-    /// Transform GPU data.
-    GPU::ShaderData mTransformGPUData;
-
     /// Reference to this object's coordinate system.
     std::shared_ptr<CoordinateSystem> mCoordinateSystem;
 
@@ -4,8 +4,12 @@
 #include <vector>
 #include <memory>
 #include <thread>
+#include <map>
+#include <string>
 #include <binding.h>
 #include <shader_data.h>
+#include <buffer.h>
+#include <memory_registry.h>
 #include <sphere.h>
 #include <shader.h>
 #include <mutex>
@@ -32,6 +36,9 @@ public:
     /// Destructor.
     ~MTField();
 
+    /// \see Model::GetName()
+    inline std::string GetName() const override { return "MT field"; };
+
 protected:
     /// \see Model::drawSpecific()
     void drawSpecific() override;
@@ -134,10 +141,12 @@ private:
     /// \param[in] fadeEnabled New view mode.
     void setVisibleSlices(State::CameraMode previous, State::CameraMode next);
 
-    /// Generate a vertex buffer object for data.
-    /// \param[in] data The data to send to the GPU.
-    /// \return VBO index.
-    template<typename T> GLuint genVBO(const std::vector<T>& data) const;
+    /// \brief Select the program pipeline variant for the current state.
+    ///
+    /// Variants are compiled on first use and kept for the lifetime of
+    /// the object.
+    void updateProgramPipeline();
+
 
     /// Get the maximum number of spheres rendered.
     /// \return The maximum number of spheres rendered.
@@ -153,6 +162,9 @@ private:
     /// \param[in] nbSpheres Number of spheres for the slice of interest.
     void scaleSpheres(unsigned int sliceId, unsigned int nbSpheres);
 
+    /// Push the voxel grid data to the per-frame ring and bind it.
+    void uploadGridData();
+
     /// Mutex for multithreading.
     std::mutex mMutex;
 
@@ -178,14 +190,20 @@ private:
     GLuint mVAO;
 
     /// Elements buffer object.
-    GLuint mIndicesBO;
+    GPU::Buffer mIndicesBO;
 
     /// DrawElementsIndirect buffer object.
-    GLuint mIndirectBO;
+    GPU::Buffer mIndirectBO;
 
     /// Compute shader for sphere deformation.
     GPU::ShaderProgram mComputeShader;
 
+    /// Fragment shader shared by all pipeline variants.
+    GPU::ShaderProgram mFragmentShader;
+
+    /// Program pipeline variants, by state combination.
+    std::map<unsigned int, GPU::ProgramPipeline> mPipelineVariants;
+
     /// Tensor values GPU data.
     GPU::ShaderData mTensorValuesData;
 
@@ -207,8 +225,8 @@ private:
     /// Radial diffusivities values of tensors GPU data
     GPU::ShaderData mRDsValuesData;
 
-    /// Voxel grid GPU data.
-    GPU::ShaderData mGridInfoData;
+    /// Voxel grid data, streamed to the GPU each time it is used.
+    GridData mGridData;
 
     /// Sphere vertices GPU data.
     GPU::ShaderData mSphereVerticesData;
@@ -225,5 +243,8 @@ private:
 
     /// DrawElementsIndirectCommand array.
     std::vector<DrawElementsIndirectCommand> mIndirectCmd;
+
+    /// Host memory of mIndices and mIndirectCmd, in the memory registry.
+    Utilities::MemoryRecord mDrawCommandsMemory;
 };
 } // namespace Slicer
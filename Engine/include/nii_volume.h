@@ -4,7 +4,10 @@
 #include <stdexcept>
 #include <memory>
 #include <vector>
+#include <algorithm>
+#include <cstdlib>
 #include <glm/glm.hpp>
+#include <memory_registry.h>
 #include "nifti1_io.h"
 
 namespace Slicer
@@ -36,26 +39,63 @@ enum class DataType
 template <typename T> class NiftiImageWrapper
 {
 public:
+    /// Edge of the bricks of the bricked layout, in voxels. Must match
+    /// BRICK_SIZE in orthogrid_util.glsl.
+    static constexpr int BRICK_SIZE = 8;
+
     /// Default constructor.
     NiftiImageWrapper()
     :mHeader()
     ,mImage()
     ,mVoxelData()
+    ,mVoxelDataMemory()
+    ,mIsBricked(false)
     {
     };
 
     /// Constructor
     /// \param[in] path Path to file.
     NiftiImageWrapper(const std::string& path)
+    :mHeader()
+    ,mImage()
+    ,mVoxelData()
+    ,mVoxelDataMemory()
+    ,mIsBricked(false)
     {
-        nifti_1_header* header = nifti_read_header(path.c_str(), nullptr, true);
-        mHeader.reset(header);
-        mImage.reset(nifti_image_read(path.c_str(), false));
-
-        // copy image data
+        // The file is decoded once, header and voxels together.
         nifti_image* image = nifti_image_read(path.c_str(), true);
+        if(image == nullptr)
+        {
+            throw std::runtime_error("Cannot read image " + path + ".");
+        }
+        mHeader.reset(new nifti_1_header(nifti_convert_nim2nhdr(image)));
+        mImage.reset(image);
+
+        // copy image data, the metadata is kept
         copyImageVoxels(image);
-        nifti_image_free(image);
+        nifti_image_unload(image);
+        mVoxelDataMemory = Utilities::MemoryRecord(getFileName(path), "voxels",
+                                                   mVoxelData.size() * sizeof(T));
+    };
+
+    /// Read the dimensions of an image without reading its voxels.
+    /// \param[in] path Path to file.
+    /// \param[out] dims Dimensions of image.
+    /// \return True if the header could be read.
+    static bool ReadDims(const std::string& path, glm::ivec4& dims)
+    {
+        nifti_1_header* header = nifti_read_header(path.c_str(), nullptr, true);
+        if(header == nullptr)
+        {
+            return false;
+        }
+        // Missing dimensions have a size of 1.
+        for(int i = 0; i < 4; ++i)
+        {
+            dims[i] = i < header->dim[0] ? std::max<int>(1, header->dim[i + 1]) : 1;
+        }
+        free(header);
+        return true;
     };
 
     /// Destructor.
@@ -63,7 +103,78 @@ public:
 
     /// Get the data vector.
     /// \return Vector of voxel data.
-    inline std::vector<T> GetVoxelData() const {return mVoxelData;};
+    inline const std::vector<T>& GetVoxelData() const {return mVoxelData;};
+
+    /// Free the voxel data. The header and dimensions are kept.
+    void ReleaseVoxelData()
+    {
+        std::vector<T>().swap(mVoxelData);
+        mVoxelDataMemory = Utilities::MemoryRecord();
+    };
+
+    /// \brief Reorder the voxels by bricks of BRICK_SIZE^3 voxels.
+    ///
+    /// Bricks are stored x-fastest, the voxels of a brick in Morton
+    /// order, so that the voxels of a slice along any axis are grouped
+    /// in a few contiguous ranges. The grid is padded to whole bricks
+    /// with zeros. The values of a voxel stay contiguous.
+    void ConvertToBricks()
+    {
+        if(mIsBricked)
+        {
+            return;
+        }
+        const glm::ivec4 dims = GetDims();
+        const glm::ivec3 nbBricks = (glm::ivec3(dims) + BRICK_SIZE - 1) / BRICK_SIZE;
+        const size_t nbValues = static_cast<size_t>(nbBricks.x) * nbBricks.y * nbBricks.z
+                              * BRICK_SIZE * BRICK_SIZE * BRICK_SIZE * dims.w;
+        std::vector<T> bricks(nbValues, static_cast<T>(0));
+        size_t flatIndex = 0;
+        for(int k = 0; k < dims.z; ++k)
+        {
+            for(int j = 0; j < dims.y; ++j)
+            {
+                for(int i = 0; i < dims.x; ++i)
+                {
+                    const size_t brickedIndex = GetBrickedVoxelIndex(glm::ivec3(i, j, k), glm::ivec3(dims));
+                    std::copy(mVoxelData.begin() + flatIndex, mVoxelData.begin() + flatIndex + dims.w,
+                              bricks.begin() + brickedIndex * dims.w);
+                    flatIndex += dims.w;
+                }
+            }
+        }
+        mVoxelData.swap(bricks);
+        mVoxelDataMemory.Resize(mVoxelData.size() * sizeof(T));
+        mIsBricked = true;
+    };
+
+    /// Get whether the voxels are ordered by bricks.
+    /// \return True after ConvertToBricks().
+    inline bool IsBricked() const { return mIsBricked; };
+
+    /// Get the index of a voxel in the bricked layout.
+    /// \param[in] index Position of the voxel on the grid.
+    /// \param[in] dims Dimensions of the grid.
+    /// \return Index of the voxel in the bricked voxel data.
+    static size_t GetBrickedVoxelIndex(const glm::ivec3& index, const glm::ivec3& dims)
+    {
+        const glm::ivec3 nbBricks = (dims + BRICK_SIZE - 1) / BRICK_SIZE;
+        const glm::ivec3 brick = index / BRICK_SIZE;
+        const glm::ivec3 position = index % BRICK_SIZE;
+        size_t mortonCode = 0;
+        for(int bit = 0; (1 << bit) < BRICK_SIZE; ++bit)
+        {
+            mortonCode |= static_cast<size_t>((position.x >> bit) & 1) << (3 * bit)
+                        | static_cast<size_t>((position.y >> bit) & 1) << (3 * bit + 1)
+                        | static_cast<size_t>((position.z >> bit) & 1) << (3 * bit + 2);
+        }
+        const size_t brickIndex = (static_cast<size_t>(brick.z) * nbBricks.y + brick.y) * nbBricks.x + brick.x;
+        return brickIndex * BRICK_SIZE * BRICK_SIZE * BRICK_SIZE + mortonCode;
+    };
+
+    /// Get the data type of the image on disk.
+    /// \return The image data type as an enum element.
+    inline DataType GetDataType() const {return datatype();};
 
     /// Get the maximum values in the image.
     /// \return max value.
@@ -90,6 +201,15 @@ public:
     };
 
 private:
+    /// Get the file name of a path.
+    /// \param[in] path Path to file.
+    /// \return The file name, without its directories.
+    static std::string getFileName(const std::string& path)
+    {
+        const size_t separator = path.find_last_of("/\\");
+        return separator == std::string::npos ? path : path.substr(separator + 1);
+    };
+
     /// Copy voxel values to mVoxelData.
     /// \param[in] image Pointer to the nifti_image to read.
     void copyImageVoxels(nifti_image* image)
@@ -257,5 +377,11 @@ private:
 
     /// Voxel data.
     std::vector<T> mVoxelData;
+
+    /// Host memory of mVoxelData, in the memory registry.
+    Utilities::MemoryRecord mVoxelDataMemory;
+
+    /// Are the voxels ordered by bricks?
+    bool mIsBricked;
 };
 } // namespace Slicer
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <nii_volume.h>
+#include <memory_registry.h>
+#include <thread_pool.h>
+
+namespace Slicer
+{
+/// \brief Volume normalized to a compact unsigned texel format.
+///
+/// The conversion runs once, in parallel. A first pass computes the
+/// extrema and a histogram of the voxel values. The histogram gives
+/// the intensity window used to normalize the values in a second pass.
+class NormalizedVolume
+{
+public:
+    /// Texel formats produced by the conversion.
+    enum class Format
+    {
+        r8,
+        r16,
+        rgb10a2
+    };
+
+    /// Constructor.
+    /// \param[in] image Image to convert. Must have 1 or 3 channels.
+    /// \param[in] lowPercentile Percentile mapped to 0, in [0, 100].
+    /// \param[in] highPercentile Percentile mapped to 1, in [0, 100].
+    /// \param[in] pool Worker threads running the conversion.
+    NormalizedVolume(const NiftiImageWrapper<float>& image,
+                     float lowPercentile, float highPercentile,
+                     Utilities::ThreadPool& pool);
+
+    /// Get the converted texels.
+    /// \return Texels, x-fastest, tightly packed.
+    inline const std::vector<unsigned char>& GetTexels() const { return mTexels; };
+
+    /// Get the texel format.
+    /// \return Texel format.
+    inline Format GetFormat() const { return mFormat; };
+
+    /// Get the size of a texel.
+    /// \return Size of a texel in bytes.
+    inline size_t GetTexelSize() const { return mTexelSize; };
+
+    /// Get the number of channels of the volume.
+    /// \return Number of channels (1 or 3).
+    inline int GetNbChannels() const { return mNbChannels; };
+
+    /// Get the dimensions of the volume.
+    /// \return Dimensions of the volume.
+    inline glm::ivec3 GetDims() const { return mDims; };
+
+    /// Get the intensity window.
+    /// \return Values mapped to 0 and 1 respectively.
+    inline glm::vec2 GetWindow() const { return mWindow; };
+
+private:
+    /// Compute the intensity window from the voxel values.
+    /// \param[in] data Voxel values.
+    /// \param[in] lowPercentile Percentile mapped to 0.
+    /// \param[in] highPercentile Percentile mapped to 1.
+    /// \param[in] pool Worker threads.
+    void computeWindow(const std::vector<float>& data,
+                       float lowPercentile, float highPercentile,
+                       Utilities::ThreadPool& pool);
+
+    /// Convert the voxel values to texels.
+    /// \param[in] data Voxel values.
+    /// \param[in] pool Worker threads.
+    void convert(const std::vector<float>& data, Utilities::ThreadPool& pool);
+
+    /// Dimensions of the volume.
+    glm::ivec3 mDims;
+
+    /// Number of channels of the texels.
+    int mNbChannels;
+
+    /// Number of values per voxel in the source image.
+    int mSourceStride;
+
+    /// Texel format.
+    Format mFormat;
+
+    /// Size of a texel in bytes.
+    size_t mTexelSize;
+
+    /// Intensity window.
+    glm::vec2 mWindow;
+
+    /// Converted texels.
+    std::vector<unsigned char> mTexels;
+
+    /// Host memory of mTexels, in the memory registry.
+    Utilities::MemoryRecord mTexelsMemory;
+};
+} // namespace Slicer
@@ -0,0 +1,175 @@
+#pragma once
+#include <glad/glad.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Slicer
+{
+namespace Utilities
+{
+/// \brief Frame profiler measuring named zones on the CPU and the GPU.
+///
+/// Zones are opened and closed with ProfilerZone objects and may be
+/// nested. GPU times are measured with pairs of timestamp queries that
+/// are read back a few frames later, once available, so that profiling
+/// never waits on the GPU. Must only be used from the OpenGL thread.
+class Profiler
+{
+public:
+    /// Statistics of a zone, rolling over the last frames.
+    struct ZoneStats
+    {
+        /// Name of the zone.
+        std::string Name;
+
+        /// Nesting depth of the zone, 0 for top level zones.
+        int Depth;
+
+        /// CPU times in milliseconds, oldest first.
+        std::vector<float> CPUHistory;
+
+        /// GPU times in milliseconds, oldest first.
+        std::vector<float> GPUHistory;
+
+        /// Average CPU time in milliseconds.
+        float CPUAverage;
+
+        /// Average GPU time in milliseconds.
+        float GPUAverage;
+    };
+
+    /// Get the profiler of the application.
+    /// \return The profiler instance.
+    static Profiler& Instance();
+
+    /// Enable or disable profiling. Zones are ignored while disabled.
+    /// \param[in] enabled True to enable profiling.
+    /// \note The change is applied by the next EndFrame().
+    void SetEnabled(bool enabled);
+
+    /// Is profiling enabled?
+    /// \return True if profiling is enabled.
+    inline bool IsEnabled() const { return mIsEnabled; };
+
+    /// Open a zone.
+    /// \param[in] name Name of the zone.
+    void BeginZone(const std::string& name);
+
+    /// Close the last opened zone.
+    void EndZone();
+
+    /// \brief Close the current frame.
+    ///
+    /// Zones opened since the previous call belong to the frame. GPU
+    /// results of earlier frames are collected if they are available.
+    void EndFrame();
+
+    /// Get the statistics of all zones, in order of first appearance.
+    /// \return Statistics of all zones.
+    inline const std::vector<ZoneStats>& GetZoneStats() const { return mZoneStats; };
+
+private:
+    /// Zone measured during a frame.
+    struct ZoneRecord
+    {
+        /// Index of the zone statistics.
+        size_t StatsIndex;
+
+        /// CPU start time.
+        std::chrono::steady_clock::time_point CPUStart;
+
+        /// CPU time in milliseconds.
+        float CPUTime;
+
+        /// Index of the query at the start of the zone.
+        size_t BeginQuery;
+
+        /// Index of the query at the end of the zone.
+        size_t EndQuery;
+    };
+
+    /// Zones and timestamp queries of a frame.
+    struct FrameRecord
+    {
+        /// Default constructor.
+        FrameRecord()
+        :Zones()
+        ,Queries()
+        ,NbUsedQueries(0){};
+
+        /// Zones of the frame.
+        std::vector<ZoneRecord> Zones;
+
+        /// Timestamp query objects.
+        std::vector<GLuint> Queries;
+
+        /// Number of queries issued during the frame.
+        size_t NbUsedQueries;
+    };
+
+    /// Constructor.
+    Profiler();
+
+    /// Issue a timestamp query in the current frame.
+    /// \return Index of the query in the current frame.
+    size_t issueTimestamp();
+
+    /// Collect the GPU results of a frame, if available.
+    /// \param[in] frame Frame to collect.
+    void collectFrame(FrameRecord& frame);
+
+    /// Get the statistics of a zone, created if missing.
+    /// \param[in] name Name of the zone.
+    /// \param[in] depth Nesting depth of the zone.
+    /// \return Index of the zone statistics.
+    size_t getStatsIndex(const std::string& name, int depth);
+
+    /// Append a time to a rolling history.
+    /// \param[in] time Time in milliseconds.
+    /// \param[in,out] history History to update.
+    /// \param[out] average Average of the history.
+    static void pushHistory(float time, std::vector<float>& history, float& average);
+
+    /// Is profiling enabled?
+    bool mIsEnabled;
+
+    /// Is profiling enabled from the next frame?
+    bool mIsEnableRequested;
+
+    /// Frames in flight, the current frame is mFrames[mCurrentFrame].
+    std::vector<FrameRecord> mFrames;
+
+    /// Index of the current frame.
+    size_t mCurrentFrame;
+
+    /// Indices of the zones currently opened, in the current frame.
+    std::vector<size_t> mOpenZones;
+
+    /// Statistics of all zones.
+    std::vector<ZoneStats> mZoneStats;
+
+    /// Index of the statistics by zone name and depth.
+    std::map<std::pair<std::string, int>, size_t> mZoneStatsIndices;
+};
+
+/// \brief Zone profiled for its lifetime.
+///
+/// The zone opens on construction and closes on destruction.
+class ProfilerZone
+{
+public:
+    /// Constructor.
+    /// \param[in] name Name of the zone.
+    ProfilerZone(const std::string& name);
+
+    /// Destructor.
+    ~ProfilerZone();
+
+private:
+    /// Was the zone opened?
+    bool mIsOpen;
+};
+} // namespace Utilities
+} // namespace Slicer
@@ -2,6 +2,7 @@
 #include <application_state.h>
 #include <coordinate_system.h>
 #include <model.h>
+#include <camera.h>
 #include <vector>
 
 namespace Slicer
@@ -31,7 +32,12 @@ public:
     void AddTexture();
 
     /// Render the scene.
-    void Render();
+    /// \param[in] camera Camera the scene is rendered from.
+    void Render(const Camera& camera);
+
+    /// Does any model need more frames to complete its updates?
+    /// \return True if a model has asynchronous work in flight.
+    bool HasPendingUpdates() const;
 
 private:
     /// Reference to the Scene's CoordinateSystem.
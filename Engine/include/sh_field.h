@@ -1,15 +1,24 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <array>
 #include <vector>
 #include <memory>
 #include <thread>
+#include <future>
 #include <binding.h>
 #include <shader_data.h>
+#include <buffer.h>
+#include <brick_cache.h>
+#include <low_rank_sh_volume.h>
+#include <memory_registry.h>
 #include <sphere.h>
 #include <shader.h>
 #include <mutex>
+#include <map>
+#include <string>
 #include <model.h>
+#include <thread_pool.h>
 
 namespace Slicer
 {
@@ -75,6 +84,27 @@ public:
     /// Destructor.
     ~SHField();
 
+    /// \see Model::GetName()
+    inline std::string GetName() const override { return "SH field"; };
+
+    /// \see Model::HasPendingUpdates()
+    bool HasPendingUpdates() const override;
+
+    /// \brief Fill the draw commands of a range of spheres.
+    ///
+    /// All spheres share the same triangulation, offset by the
+    /// vertices of each sphere.
+    /// \param[in] nbElements Number of element indices of a single sphere.
+    /// \param[in] firstElement Offset of the triangulation in the element buffer.
+    /// \param[in] nbSphereVertices Number of vertices of a single sphere.
+    /// \param[in] firstIndex Index (flat) of the first sphere to fill.
+    /// \param[in] lastIndex Index (exclusive) of the last sphere to fill.
+    /// \param[out] commands Draw commands of all spheres, preallocated.
+    static void FillDrawCommands(unsigned int nbElements, unsigned int firstElement,
+                                 size_t nbSphereVertices,
+                                 size_t firstIndex, size_t lastIndex,
+                                 std::vector<DrawElementsIndirectCommand>& commands);
+
 protected:
     /// \see Model::drawSpecific()
     void drawSpecific() override;
@@ -121,28 +151,166 @@ private:
         unsigned int CurrentSlice;
     };
 
+    /// Struct containing the parameters of the level of detail pass.
+    ///
+    /// The order of members is critical. The same order must be used
+    /// when declaring the struct on the GPU.
+    struct LevelOfDetailData
+    {
+        float ViewportHeight;
+        float LevelZeroRadius;
+        float AggregateRadius;
+        unsigned int NbLevels;
+        unsigned int FirstSphere;
+        unsigned int NbSpheres;
+        unsigned int QuadFirstIndex;
+    };
+
+    /// Struct containing the SH bands evaluated by a deformation pass.
+    ///
+    /// The order of members is critical. The same order must be used
+    /// when declaring the struct on the GPU.
+    struct DeformationData
+    {
+        unsigned int FirstCoeff;
+        unsigned int LastCoeff;
+    };
+
+    /// \brief Sphere of a resolution and the glyph storage sized for it.
+    ///
+    /// The sphere and the draw commands are built on a worker thread.
+    /// The storage is then allocated and uploaded by chunks on the
+    /// rendering thread, before it replaces the storage in use.
+    struct SphereBuild
+    {
+        /// Resolution of the sphere.
+        int Resolution;
+
+        /// Sphere used for SH projection.
+        std::shared_ptr<Primitive::Sphere> Sphere;
+
+        /// SH functions at each point of the sphere.
+        std::vector<float> SHFuncs;
+
+        /// Triangulations of the levels of detail, followed by the quad
+        /// of aggregated glyphs.
+        std::vector<GLuint> ElementIndices;
+
+        /// Draw commands of all spheres.
+        std::vector<DrawElementsIndirectCommand> Commands;
+
+        /// Is the storage allocated?
+        bool IsAllocated;
+
+        /// Bytes of SHFuncs uploaded to SphHarmFuncsData.
+        size_t NbUploadedSHFuncsBytes;
+
+        /// Bytes of Commands uploaded to IndirectBO.
+        size_t NbUploadedCommandsBytes;
+
+        /// Elements buffer object.
+        GPU::Buffer IndicesBO;
+
+        /// DrawElementsIndirect buffer object.
+        GPU::Buffer IndirectBO;
+
+        /// Element count and offset of each level of detail GPU data.
+        GPU::ShaderData LevelsData;
+
+        /// SH functions GPU data.
+        GPU::ShaderData SphHarmFuncsData;
+
+        /// Sphere vertices GPU data.
+        GPU::ShaderData SphereVerticesData;
+
+        /// Sphere triangulation (indices) GPU data.
+        GPU::ShaderData SphereIndicesData;
+
+        /// Glyphs radiis GPU data, two buffers for all planes.
+        std::array<GPU::ShaderData, 2> AllRadiisData;
+
+        /// Glyphs maximum radius GPU data, two buffers for all planes.
+        std::array<GPU::ShaderData, 2> AllMaxAmplitudeData;
+
+        /// Glyphs normals GPU data, two buffers for all planes.
+        std::array<GPU::ShaderData, 2> AllSpheresNormalsData;
+
+        /// Slice deformed in the first buffer of each plane, -1 if none.
+        std::array<int, 3> Slices;
+
+        /// Number of SH coefficients evaluated for each tile of the first
+        /// buffer of each plane. Empty when no tile is deformed.
+        std::array<std::vector<GLuint>, 3> TileNbCoeffs;
+
+        /// Fence signaled when the tiles of the first buffer are deformed,
+        /// nullptr while they are not scheduled.
+        GLsync DeformationFence;
+    };
+
     /// \brief Initialize class members.
     ///
-    /// Calls copySHCoefficientsFromImage() and
-    /// initializeDrawCommand() on different threads.
+    /// Builds the sphere of the requested resolution and its storage.
     void initializeMembers();
 
     /// Initialize data to be copied on the GPU.
     void initializeGPUData();
 
-    /// Initialize a subset of the Draw commands, used for instancing.
-    /// \param[in] firstIndex Index (flat) of the first sphere to initialize.
-    /// \param[in] lastIndex Index (exclusive) of the last sphere to initialize.
-    void initializeSubsetDrawCommand(size_t firstIndex, size_t lastIndex);
+    /// \brief Build a sphere and the draw commands of all spheres.
+    ///
+    /// Only reads its arguments, it can run on any thread.
+    /// \param[in] resolution Resolution of the sphere.
+    /// \param[in] nbCoeffs Number of SH coefficients.
+    /// \param[in] nbSpheres Number of spheres of all planes.
+    /// \param[in] lowRankVolume Compressed coefficients the SH functions
+    ///                          are projected for, nullptr if none.
+    /// \return The sphere, without GPU storage.
+    static std::unique_ptr<SphereBuild> buildSphere(int resolution, unsigned int nbCoeffs,
+                                                    unsigned int nbSpheres,
+                                                    std::shared_ptr<const LowRankSHVolume> lowRankVolume);
+
+    /// \brief Allocate the storage of a sphere and upload a chunk of it.
+    ///
+    /// The small arrays are uploaded with the allocation, the SH
+    /// functions and the draw commands by chunks.
+    /// \param[in] build Sphere whose storage to upload.
+    /// \param[in] maxNbBytes Maximum number of bytes of the chunk.
+    /// \return True when the storage is complete.
+    bool uploadSphereChunk(SphereBuild& build, size_t maxNbBytes) const;
+
+    /// \brief Deform the tiles drawn from the front buffers into the first
+    /// buffer of a sphere, with the same SH coefficients.
+    ///
+    /// The sphere in use is drawn until the deformation is done, the swap
+    /// to the new sphere then hides no glyph.
+    /// \param[in] build Sphere with a complete storage.
+    void deformSphereBuild(SphereBuild& build);
 
-    /// Dispatch some method for filling arrays in parallel.
-    /// \param[in] fn Pointer to member function to call.
-    /// \param[in] nbElements Number of elements to fill.
-    /// \param[in] nbThreads Number of threads to use.
-    /// \param[out] threads Vector of threads.
-    void dispatchSubsetCommands(void(SHField::*fn)(size_t, size_t),
-                               size_t nbElements, size_t nbThreads,
-                               std::vector<std::thread>& threads);
+    /// \brief Replace the sphere and the storage in use.
+    ///
+    /// Only the tiles deformed by deformSphereBuild() are kept, the other
+    /// tiles must be deformed again. Deformations in flight for the
+    /// previous storage are abandoned.
+    /// \param[in] build Sphere with a complete storage.
+    void applySphereBuild(std::unique_ptr<SphereBuild> build);
+
+    /// Get the sphere parameters of the GPU.
+    /// \param[in] sphere Sphere used for SH projection.
+    /// \return Parameters of the sphere and of the sphere state.
+    SphereData getSphereData(const Primitive::Sphere& sphere) const;
+
+    /// \brief Follow the requested sphere resolution.
+    ///
+    /// Called once per draw on the rendering thread. Starts the build of
+    /// the requested resolution on the worker thread, uploads a chunk of
+    /// a finished build, deforms the tiles in use once its upload is
+    /// complete, and replaces the sphere once they are deformed. Builds
+    /// of a resolution that is no longer requested are discarded.
+    void updateSphereResolution();
+
+    /// Set the sphere resolution.
+    /// \param[in] previous Previous resolution.
+    /// \param[in] resolution New resolution.
+    void setSphereResolution(int previous, int resolution);
 
     /// Set sphere scaling.
     /// \param[in] previous Previous scaling multiplier.
@@ -179,10 +347,16 @@ private:
     /// \param[in] fadeEnabled New view mode.
     void setVisibleSlices(State::CameraMode previous, State::CameraMode next);
 
-    /// Generate a vertex buffer object for data.
-    /// \param[in] data The data to send to the GPU.
-    /// \return VBO index.
-    template<typename T> GLuint genVBO(const std::vector<T>& data) const;
+    /// \brief Select the program pipeline variant for the current state.
+    ///
+    /// Variants are compiled on first use and kept for the lifetime of
+    /// the object.
+    void updateProgramPipeline();
+
+    /// Get the definitions common to all shader variants.
+    /// \return Preprocessor definitions.
+    std::vector<std::string> getBaseDefines() const;
+
 
     /// Get the maximum number of spheres rendered.
     /// \return The maximum number of spheres rendered.
@@ -190,20 +364,110 @@ private:
                                                          mNbSpheresY +
                                                          mNbSpheresZ; };
 
-    /// Scale spheres by launching a compute shader pass.
+    /// \brief Swap the planes whose deformation is done and deform the
+    /// tiles seen by the views that are stale.
+    ///
+    /// Called once per draw on the rendering thread. Never blocks: a plane
+    /// whose deformation is still running is checked again next frame.
     void scaleSpheres();
 
-    /// Scale spheres for a single slice.
-    /// \param[in] sliceId Index of the slice to scale.
-    /// \param[in] nbSpheres Number of spheres for the slice of interest.
-    void scaleSpheres(unsigned int sliceId, unsigned int nbSpheres);
+    /// \brief Deform the tiles of a plane seen by any view that are missing
+    /// or not fully refined, into the back buffer of the plane.
+    ///
+    /// Tiles first get a preview from the low order bands, then the
+    /// remaining bands are added to the radii of the front buffer. The
+    /// other tiles deformed in the front buffer are copied, the back
+    /// buffer never has fewer deformed tiles than the front buffer.
+    /// \param[in] sliceId Index of the plane (0: X, 1: Y, 2: Z).
+    void scaleSpheres(unsigned int sliceId);
+
+    /// \brief Deform a list of tiles of a plane in its back buffer.
+    ///
+    /// The plane is the current slice of the grid data last uploaded.
+    /// When firstCoeff is not 0, the bands are added to the radii of the
+    /// front buffer, evaluated for the coefficients before firstCoeff.
+    /// When firstCoeff is lastCoeff, the tiles are copied from the front
+    /// buffer.
+    /// \param[in] firstCoeff First SH coefficient to evaluate.
+    /// \param[in] lastCoeff Last SH coefficient (exclusive) to evaluate.
+    /// \param[in] tiles Flat indices of the tiles to deform.
+    void scaleTiles(unsigned int firstCoeff, unsigned int lastCoeff,
+                    const std::vector<GLuint>& tiles);
+
+    /// \brief Get the tiles of a plane that can be seen from the camera
+    /// of the current draw.
+    ///
+    /// No tile is in view when the view mode hides the plane.
+    /// \param[in] sliceId Index of the plane (0: X, 1: Y, 2: Z).
+    /// \return Flat indices of the tiles whose bounding box intersects
+    ///         the frustum, for the requested slice.
+    std::vector<GLuint> getTilesInView(unsigned int sliceId) const;
+
+    /// Get the grid axes along the rows and columns of a plane.
+    /// \param[in] sliceId Index of the plane (0: X, 1: Y, 2: Z).
+    /// \return Axis of the fastest varying index, then the other axis.
+    glm::ivec2 getPlaneAxes(unsigned int sliceId) const;
+
+    /// Get the number of spheres of a plane.
+    /// \param[in] sliceId Index of the plane (0: X, 1: Y, 2: Z).
+    /// \return Number of spheres of the plane.
+    unsigned int getNbSpheres(unsigned int sliceId) const;
+
+    /// Get the index of the first sphere of a plane in the glyph buffers.
+    /// \param[in] sliceId Index of the plane (0: X, 1: Y, 2: Z).
+    /// \return Flat index of the first sphere of the plane.
+    unsigned int getFirstSphere(unsigned int sliceId) const;
+
+    /// \brief Select the level of detail of each glyph for the current draw.
+    ///
+    /// A compute pass writes the element range of the level matching
+    /// the size of each glyph on screen in its draw command. Only the
+    /// planes with tiles in view are processed, the commands of the
+    /// other planes are left as is.
+    void selectLevelsOfDetail();
+
+    /// Get the SH coefficients to copy on the GPU.
+    /// \return Compressed values if the image is compressed, else the
+    ///         coefficients of the image.
+    const std::vector<float>& getSHCoeffs() const;
+
+    /// Get the number of values per voxel of the SH coefficients on the GPU.
+    /// \return Number of values evaluated per sphere vertex.
+    unsigned int getNbValuesPerVoxel() const;
+
+    /// Get the number of bricks of the SH coefficients along each axis.
+    /// \return Number of bricks along X, Y and Z.
+    glm::ivec3 getNbBricks() const;
+
+    /// \brief Make the bricks of the slices in use resident in the cache.
+    ///
+    /// The slices of both buffers of each plane are read by the draws,
+    /// the requested slices by the deformations. Does nothing when the
+    /// whole image lives on the GPU.
+    void updateResidentBricks();
 
-    /// Mutex for multithreading.
-    std::mutex mMutex;
+    /// Push the voxel grid data to the per-frame ring and bind it.
+    /// \param[in] gridData Voxel grid data to push.
+    void uploadGridData(const GridData& gridData);
 
     /// Sphere used for SH projection.
     std::shared_ptr<Primitive::Sphere> mSphere;
 
+    /// Resolution of mSphere.
+    int mResolution;
+
+    /// Latest resolution requested by the application.
+    int mRequestedResolution;
+
+    /// Worker thread building the spheres of new resolutions.
+    std::unique_ptr<Utilities::ThreadPool> mSphereBuilder;
+
+    /// Sphere built by the worker thread, invalid when no build is running.
+    std::future<std::unique_ptr<SphereBuild>> mSphereBuild;
+
+    /// Sphere whose storage is being uploaded, nullptr if none.
+    std::unique_ptr<SphereBuild> mPendingSphere;
+
     /// Maximum number of spheres rendered in X-plane.
     unsigned int mNbSpheresX;
 
@@ -213,32 +477,81 @@ private:
     /// Maximum number of spheres rendered in Z-plane.
     unsigned int mNbSpheresZ;
 
-    /// Indicates what slices need to be computed.
-    glm::bvec3 mIsSliceDirty;
+    /// Latest slice indices requested by the application.
+    glm::ivec3 mRequestedSlices;
+
+    /// Front buffer of each plane, drawn while the back buffer is deformed.
+    std::array<unsigned int, 3> mFrontBuffers;
+
+    /// Slice deformed in each buffer of each plane, -1 if none.
+    std::array<std::array<int, 2>, 3> mBufferSlices;
+
+    /// Number of SH coefficients evaluated for each tile of each buffer
+    /// of each plane. 0 when the tile is not deformed.
+    std::array<std::array<std::vector<GLuint>, 2>, 3> mTileNbCoeffs;
+
+    /// Number of tiles along the rows and columns of each plane.
+    std::array<glm::uvec2, 3> mNbTiles;
+
+    /// Tiles of each plane seen by any view since the requested slice
+    /// of the plane changed. Views only see some of them at each draw.
+    std::array<std::vector<bool>, 3> mSeenTiles;
+
+    /// Requested slice of each plane the seen tiles belong to.
+    std::array<int, 3> mSeenTilesSlices;
+
+    /// Did each plane have seen tiles left to deform at the last draw?
+    std::array<bool, 3> mHasStaleTiles;
 
-    /// Mesh triangulation for all spheres.
-    std::vector<GLuint> mIndices;
+    /// Number of SH coefficients evaluated for the preview of a new slice.
+    unsigned int mNbPreviewCoeffs;
+
+    /// Fences signaled when the deformation of a plane is done,
+    /// nullptr when no deformation is running for the plane.
+    std::array<GLsync, 3> mDeformationFences;
 
     /// Vertex array object.
     GLuint mVAO;
 
-    /// Elements buffer object.
-    GLuint mIndicesBO;
+    /// Elements buffer object, with the triangulation of each level of
+    /// detail of the sphere.
+    GPU::Buffer mIndicesBO;
 
     /// DrawElementsIndirect buffer object.
-    GLuint mIndirectBO;
+    GPU::Buffer mIndirectBO;
 
     /// Compute shader for sphere deformation.
     GPU::ShaderProgram mComputeShader;
 
-    /// SH coefficients GPU data.
+    /// Compute shader selecting the level of detail of the glyphs.
+    GPU::ShaderProgram mLevelOfDetailShader;
+
+    /// Element count and offset of each level of detail GPU data.
+    GPU::ShaderData mLevelsData;
+
+    /// Fragment shader shared by all pipeline variants.
+    GPU::ShaderProgram mFragmentShader;
+
+    /// Program pipeline variants, by state combination.
+    std::map<unsigned int, GPU::ProgramPipeline> mPipelineVariants;
+
+    /// SH coefficients compressed to a low-rank basis, nullptr when the
+    /// coefficients of the image are used as is.
+    std::shared_ptr<const LowRankSHVolume> mLowRankVolume;
+
+    /// SH coefficients GPU data, empty when the cache is used.
     GPU::ShaderData mSphHarmCoeffsData;
 
+    /// Cache of the bricks of SH coefficients, nullptr when the whole
+    /// image lives on the GPU.
+    std::unique_ptr<GPU::BrickCache> mBrickCache;
+
     /// SH functions GPU data.
     GPU::ShaderData mSphHarmFuncsData;
 
-    /// Voxel grid GPU data.
-    GPU::ShaderData mGridInfoData;
+    /// Voxel grid data, streamed to the GPU each time it is used. Its
+    /// slice indices are the ones deformed in the front buffers.
+    GridData mGridData;
 
     /// Sphere vertices GPU data.
     GPU::ShaderData mSphereVerticesData;
@@ -250,19 +563,23 @@ private:
     /// \see SphereData
     GPU::ShaderData mSphereInfoData;
 
-    /// Glyphs radiis GPU data.
-    GPU::ShaderData mAllRadiisData;
+    /// Glyphs radiis GPU data, two buffers for all planes.
+    std::array<GPU::ShaderData, 2> mAllRadiisData;
 
-    /// Glyphs maximum radius GPU data.
-    GPU::ShaderData mAllMaxAmplitudeData;
+    /// Glyphs maximum radius GPU data, with the direction of the maximum
+    /// in xyz and its value in w, two buffers for all planes.
+    std::array<GPU::ShaderData, 2> mAllMaxAmplitudeData;
 
-    /// Glyphs normals GPU data.
-    GPU::ShaderData mAllSpheresNormalsData;
+    /// Glyphs normals GPU data, two buffers for all planes.
+    std::array<GPU::ShaderData, 2> mAllSpheresNormalsData;
 
     /// All SH orders, repeated.
     GPU::ShaderData mAllOrdersData;
 
     /// DrawElementsIndirectCommand array.
     std::vector<DrawElementsIndirectCommand> mIndirectCmd;
+
+    /// Host memory of mIndirectCmd, in the memory registry.
+    Utilities::MemoryRecord mDrawCommandsMemory;
 };
 } // namespace Slicer
@@ -3,6 +3,7 @@
 #include <glad/glad.h>
 #include <string>
 #include <vector>
+#include <cstdint>
 
 namespace Slicer
 {
@@ -18,10 +19,20 @@ public:
     ShaderProgram() = default;
 
     /// Constructor.
+    ///
+    /// The linked program is restored from the ShaderCache when possible.
     /// \param[in] filepath Path to shader code.
     /// \param[in] shaderType Type for the shader.
     ShaderProgram(const std::string& filepath, const GLenum shaderType);
 
+    /// Constructor for a specialized shader variant.
+    /// \param[in] filepath Path to shader code.
+    /// \param[in] shaderType Type for the shader.
+    /// \param[in] defines Preprocessor definitions (e.g. "NB_COEFFS 45u")
+    ///                    inserted after the version directive.
+    ShaderProgram(const std::string& filepath, const GLenum shaderType,
+                  const std::vector<std::string>& defines);
+
     /// Shader program ID getter.
     /// \return Program ID.
     inline const GLuint ID() const { return mProgramID; };
@@ -40,6 +51,9 @@ private:
     /// Static array of shader include path lengths (shared across all instances).
     inline static std::vector<int> mShaderIncludeLengths = {};
 
+    /// Hash of the content of all include files (shared across all instances).
+    inline static uint64_t mShaderIncludesHash = 0;
+
     /// Program ID.
     GLuint mProgramID = 0;
 
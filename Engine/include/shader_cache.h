@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+
+namespace Slicer
+{
+namespace GPU
+{
+/// \brief On-disk cache of linked separable program binaries.
+///
+/// Programs are stored with glGetProgramBinary() and restored with
+/// glProgramBinary(). The key hashes the driver identification strings
+/// with the shader type and sources, so a driver update or a shader edit
+/// results in a cache miss. Any failure falls back to compilation.
+class ShaderCache
+{
+public:
+    /// Compute the cache key of a shader program.
+    /// \param[in] shaderType Type of the shader.
+    /// \param[in] source Source code of the shader.
+    /// \param[in] includesHash Hash of the include files content.
+    /// \return Cache key.
+    static std::string ComputeKey(const GLenum shaderType,
+                                  const std::string& source,
+                                  const uint64_t includesHash);
+
+    /// Create a separable program from the cache.
+    /// \param[in] key Cache key of the program.
+    /// \return Program ID, 0 if the program is not in the cache or
+    ///         the binary was rejected by the driver.
+    static GLuint LoadProgram(const std::string& key);
+
+    /// Store a linked program in the cache.
+    /// \param[in] key Cache key of the program.
+    /// \param[in] program Linked program, created with
+    ///                    GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+    static void StoreProgram(const std::string& key, const GLuint program);
+
+    /// 64-bit FNV-1a hash.
+    /// \param[in] data Data to hash.
+    /// \param[in] size Size of data in bytes.
+    /// \param[in] hash Hash to continue from.
+    /// \return The updated hash.
+    static uint64_t Hash(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS);
+
+    /// Initial value of a FNV-1a hash.
+    static constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+
+private:
+    /// Is program binary caching supported by the driver?
+    /// \return True if at least one binary format is supported.
+    static bool isSupported();
+
+    /// Get the path of the cache file of a program.
+    /// \param[in] key Cache key of the program.
+    /// \return Path to the cache file.
+    static std::string getPath(const std::string& key);
+};
+} // namespace GPU
+} // namespace Slicer
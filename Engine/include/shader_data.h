@@ -2,7 +2,9 @@
 
 #include <glad/glad.h>
 #include <cstdlib>
+#include <string>
 #include <binding.h>
+#include <buffer.h>
 
 
 namespace Slicer
@@ -11,7 +13,9 @@ namespace GPU
 {
 /// \brief Class for managing SSBO.
 ///
-/// SSBO are memory blocks that are pushed on the GPU.
+/// SSBO are memory blocks that are pushed on the GPU. Their storage is a
+/// range sub-allocated from the BufferArena, freed with the object.
+/// ShaderData can be moved but not copied.
 class ShaderData
 {
 public:
@@ -22,40 +26,64 @@ public:
     /// \param[in] data Pointer to array to data to copy on the GPU.
     /// \param[in] binding GPU binding for data.
     /// \param[in] sizeofT Size of data to copy, in bytes.
-    ShaderData(void* data, Binding binding, size_t sizeofT);
+    ShaderData(const void* data, Binding binding, size_t sizeofT);
 
-    /// Constructor.
-    /// \param[in] data Pointer to array to data to copy on the GPU.
+    /// Constructor. Storage is allocated by the first call to Update().
     /// \param[in] binding GPU binding for data.
-    /// \param[in] sizeofT Size of data to copy, in bytes.
-    /// \param[in] usage GPU usage qualifier.
-    ShaderData(void* data, Binding binding, size_t sizeofT, GLenum usage);
+    ShaderData(Binding binding);
 
-    /// Constructor.
+    /// Constructor. Storage is allocated, its content is undefined
+    /// until written by Update() or by a shader.
     /// \param[in] binding GPU binding for data.
-    /// \param[in] usage GPU usage qualifier.
-    ShaderData(Binding binding, GLenum usage);
+    /// \param[in] sizeofT Size of the storage, in bytes.
+    ShaderData(Binding binding, size_t sizeofT);
 
-    /// Constructor.
-    /// \param[in] binding GPU binding for data.
-    ShaderData(Binding binding);
+    /// Move constructor.
+    /// \param[in] other ShaderData to move.
+    ShaderData(ShaderData&& other) noexcept;
+
+    /// Move assignment operator. The current storage is freed.
+    /// \param[in] other ShaderData to move.
+    /// \return Reference to this object.
+    ShaderData& operator=(ShaderData&& other) noexcept;
+
+    ShaderData(const ShaderData&) = delete;
+    ShaderData& operator=(const ShaderData&) = delete;
+
+    /// Destructor. Frees the storage.
+    ~ShaderData();
 
     /// Update SSBO data.
     /// \param[in] offset The byte offset in buffer where we want to perform update.
     /// \param[in] size The byte size of the buffer subdata we want to modify.
     /// \param[in] data Pointer to data of size size we want to copy at
     ///                 buffer position offset.
-    void Update(GLintptr offset, GLsizeiptr size, void* data);
+    /// \note The storage is reallocated, and its content lost, when it is
+    ///       smaller than offset + size.
+    void Update(GLintptr offset, GLsizeiptr size, const void* data);
 
     /// Copy SSBO to the GPU.
     void ToGPU();
 
+    /// Bind the storage to its binding, even if it is already bound.
+    /// Used when several objects share the same binding.
+    void Bind();
+
+    /// Bind the storage to another binding. The binding of the object
+    /// is left unchanged.
+    /// \param[in] binding GPU binding for data.
+    void Bind(Binding binding) const;
+
 private:
-    /// SSBO identifier.
-    GLuint mSSBO;
+    /// Allocate the storage from the arena.
+    /// \param[in] size Size of the storage, in bytes.
+    void allocate(GLsizeiptr size);
 
-    /// Usage qualifier.
-    GLenum mUsage;
+    /// Free the storage, if any.
+    void release();
+
+    /// Storage of the SSBO.
+    BufferRange mRange;
 
     /// GPU binding.
     Binding mBinding;
@@ -63,8 +91,11 @@ private:
     /// Is the object dirty?
     bool mIsDirty;
 
-    /// Is the buffer data initialized?
-    bool mIsInit;
+    /// Owner of the storage in the memory registry.
+    std::string mOwner;
+
+    /// Identifier of the storage in the memory registry, 0 before allocation.
+    size_t mMemoryId;
 };
 } // namespace GPU
 } //namespace Slicer
@@ -35,6 +35,19 @@ public:
     /// \return Vector of indices.
     inline std::vector<GLuint> GetIndices() const { return mIndices; };
 
+    /// \brief Get the triangulations of all levels of detail, coarsest first.
+    ///
+    /// Level l is the icosahedron subdivided l times. Subdivisions only
+    /// add points, so the triangulation of level l only uses the first
+    /// points of the sphere and all levels share the same points.
+    /// \return Vector of indices of all levels, one after the other.
+    inline std::vector<GLuint> GetLevelIndices() const { return mLevelIndices; };
+
+    /// Get the offset of the triangulation of each level of detail.
+    /// \return Vector of offsets in GetLevelIndices(), with one more
+    ///         element than there are levels.
+    inline std::vector<size_t> GetLevelFirstIndices() const { return mLevelFirstIndices; };
+
     /// Get the sphere points.
     /// \return Vector of points on the sphere.
     inline std::vector<glm::vec4> GetPoints() const { return mPoints; };
@@ -82,6 +95,12 @@ private:
     /// Sphere indices for triangulation.
     std::vector<GLuint> mIndices;
 
+    /// Triangulations of all levels of detail, coarsest first.
+    std::vector<GLuint> mLevelIndices;
+
+    /// Offset of each level in mLevelIndices, and total size.
+    std::vector<size_t> mLevelFirstIndices;
+
     /// SH functions at each point in mPoints.
     std::vector<float> mSphHarmFunc;
 
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <array>
+#include <binding.h>
+#include <buffer.h>
+
+namespace Slicer
+{
+namespace GPU
+{
+/// \brief Ring of persistently mapped storage for small per-frame data.
+///
+/// The ring is split in one region per frame in flight. Data pushed
+/// during a frame is written to the region of the frame, through a
+/// coherent persistent mapping, and bound with glBindBufferRange. When
+/// a frame ends, its region is fenced and the ring moves to the next
+/// region, waiting for the fence placed when the region was last used.
+/// Data pushed during a frame is therefore only valid until the same
+/// frame ends: it must be pushed again every frame it is used. Must
+/// only be used from the OpenGL thread.
+class StreamRing
+{
+public:
+    /// Get the ring of the application.
+    /// \return The ring instance.
+    static StreamRing& Instance();
+
+    /// Copy data to the region of the current frame.
+    /// \param[in] data Data to copy.
+    /// \param[in] size Size of data, in bytes.
+    /// \return Range of the copy, valid until the end of the frame.
+    BufferRange Push(const void* data, GLsizeiptr size);
+
+    /// Copy data to the region of the current frame and bind it.
+    /// \param[in] binding Shader storage binding.
+    /// \param[in] data Data to copy.
+    /// \param[in] size Size of data, in bytes.
+    void Bind(Binding binding, const void* data, GLsizeiptr size);
+
+    /// Close the current frame and move to the next region.
+    void EndFrame();
+
+    /// Delete the storage. Must be called while the OpenGL context is current.
+    void Clear();
+
+private:
+    /// Constructor.
+    StreamRing();
+
+    /// Create and map the storage.
+    void initialize();
+
+    /// Storage of all regions.
+    GPU::Buffer mStorage;
+
+    /// Mapped pointer to the storage.
+    char* mMappedPtr;
+
+    /// Alignment of the pushed ranges, in bytes.
+    GLsizeiptr mAlignment;
+
+    /// Fences of the regions, nullptr if the region is free.
+    std::array<GLsync, 3> mFences;
+
+    /// Index of the region of the current frame.
+    size_t mCurrentRegion;
+
+    /// Offset of the next push in the current region, in bytes.
+    GLsizeiptr mRegionOffset;
+};
+} // namespace GPU
+} // namespace Slicer
@@ -1,7 +1,14 @@
 #pragma once
 
 #include <vector>
+#include <array>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <model.h>
+#include <buffer.h>
+#include <normalized_volume.h>
 
 namespace Slicer
 {
@@ -23,6 +30,12 @@ public:
     /// Destructor.
     ~Texture();
 
+    /// \see Model::HasPendingUpdates()
+    bool HasPendingUpdates() const override;
+
+    /// \see Model::GetName()
+    inline std::string GetName() const override { return "Background"; };
+
 protected:
     /// \see Model::drawSpecific()
     void drawSpecific() override;
@@ -37,39 +50,152 @@ protected:
     void initProgramPipeline() override;
 
 private:
+    /// \brief Slice copy job for the streaming worker.
+    struct SliceJob
+    {
+        /// Plane of the slice (0: X, 1: Y, 2: Z).
+        unsigned int Plane;
+
+        /// Index of the slice of the image along the plane normal.
+        int SliceIndex;
+
+        /// Staging region (0 or 1) written by the worker.
+        unsigned int Region;
+    };
+
     /// \brief Initialize class members.
     ///
     /// Create plan for texture.
     /// Create texture.
     void initializeMembers();
 
-    /// Generate a vertex buffer object for data.
-    /// \param[in] data The data to send to the GPU.
-    /// \return VBO index.
-    template<typename T> GLuint genVBO(const std::vector<T>& data) const;
+    /// \brief Create the 3D texture containing the whole volume.
+    void initializeVolumeTexture();
 
-    /// Vertex array object.
-    GLuint mVAO;
+    /// \brief Create the per-plane 2D textures and the persistently
+    /// mapped staging buffer used in streaming mode.
+    void initializeSliceTextures();
+
+    /// Callback for slice index update.
+    /// \param[in] previous Previous slice indices.
+    /// \param[in] indices New slice indices.
+    void setSliceIndex(glm::vec3 previous, glm::vec3 indices);
+
+    /// \brief Get the slice of the image drawn for a slice of the voxel grid.
+    ///
+    /// The image can be finer than the grid, the slice is mapped the same
+    /// way as the normalized texture coordinates of the volume texture.
+    /// \param[in] plane Plane of the slice (0: X, 1: Y, 2: Z).
+    /// \param[in] gridSlice Index of the slice in the voxel grid.
+    /// \return Index of the slice in the image.
+    int getImageSlice(unsigned int plane, int gridSlice) const;
+
+    /// \brief Upload slices copied by the worker and schedule new copies.
+    ///
+    /// Called once per draw on the rendering thread. Never blocks: a plane
+    /// whose staging region is still read by the GPU is retried next frame.
+    void streamSlices();
+
+    /// \brief Streaming worker loop, extracts requested slices into the
+    /// staging buffer.
+    void streamingWorker();
+
+    /// Copy a slice of the volume into its staging region.
+    /// \param[in] job Description of the slice to copy.
+    void copySlice(const SliceJob& job) const;
 
-    /// Vertices buffer object.
-    GLuint mVerticesBO;
+    /// Stop and join the streaming worker.
+    void stopStreamingWorker();
 
-    /// Texture coordinates buffer object.
-    GLuint mTextureCoordsBO;
+    /// Vertex array object.
+    GLuint mVAO;
 
-    /// Slices buffer object.
-    GLuint mSliceBO;
+    /// Vertex buffer object, with the vertices, the texture coordinates
+    /// and the slices one after the other.
+    GPU::Buffer mVertexBO;
 
     /// Vertices vector.
     std::vector<glm::vec3> mVertices;
 
-    /// Texture data vector.
-    std::vector<float> mData;
+    /// Normalized texels. Released after upload unless streaming.
+    std::unique_ptr<NormalizedVolume> mVolume;
 
     /// Texture coordinates vector.
     std::vector<glm::vec3> mTextureCoords;
 
     /// Slices vector
     std::vector<glm::vec3> mSlice;
+
+    /// Image dimensions.
+    glm::ivec4 mDims;
+
+    /// Number of channels in the texture (1 or 3).
+    int mNbChannels;
+
+    /// Internal format of the textures.
+    GLenum mInternalFormat;
+
+    /// Pixel format of the texels.
+    GLenum mPixelFormat;
+
+    /// Pixel type of the texels.
+    GLenum mPixelType;
+
+    /// Size of a texel in bytes.
+    size_t mTexelSize;
+
+    /// Is the image streamed one slice at a time?
+    bool mIsStreaming;
+
+    /// 3D texture containing the whole volume (non-streaming mode).
+    GLuint mVolumeTexture;
+
+    /// 2D textures for the X, Y and Z planes (streaming mode).
+    std::array<GLuint, 3> mSliceTextures;
+
+    /// Persistently mapped staging buffer, two regions per plane.
+    GPU::Buffer mStagingBO;
+
+    /// Pointer to the mapped staging buffer.
+    char* mStagingPtr;
+
+    /// Offset in bytes of each staging region.
+    std::array<std::array<size_t, 2>, 3> mRegionOffsets;
+
+    /// Fences signaled when the GPU is done reading a staging region.
+    std::array<std::array<GLsync, 2>, 3> mRegionFences;
+
+    /// Region to use for the next copy of each plane.
+    std::array<unsigned int, 3> mNextRegion;
+
+    /// Latest slice indices requested by the application, in the image.
+    std::array<int, 3> mRequestedSlices;
+
+    /// Slice indices last sent to the worker, in the image.
+    std::array<int, 3> mScheduledSlices;
+
+    /// Is a copy in flight for the plane?
+    std::array<bool, 3> mIsPlaneBusy;
+
+    /// Worker thread copying slices to the staging buffer.
+    std::thread mWorker;
+
+    /// Mutex protecting the job queues.
+    std::mutex mJobsMutex;
+
+    /// Condition variable waking up the worker.
+    std::condition_variable mJobsCondition;
+
+    /// Jobs waiting to be processed by the worker.
+    std::deque<SliceJob> mPendingJobs;
+
+    /// Jobs processed by the worker, waiting for upload.
+    std::vector<SliceJob> mFinishedJobs;
+
+    /// Should the worker stop?
+    bool mStopWorker;
+
+    /// Identifiers of the textures in the memory registry.
+    std::vector<size_t> mMemoryIds;
 };
 } // namespace Slicer
@@ -0,0 +1,110 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Slicer
+{
+namespace Utilities
+{
+/// \brief Fixed size pool of worker threads.
+///
+/// Tasks are run in submission order by the first available worker.
+/// The destructor waits for all submitted tasks to complete.
+class ThreadPool
+{
+public:
+    /// Default constructor (deleted).
+    ThreadPool() = delete;
+
+    /// Constructor.
+    /// \param[in] nbThreads Number of worker threads, at least one.
+    ThreadPool(unsigned int nbThreads);
+
+    /// Copy constructor (deleted). Workers refer to the pool.
+    ThreadPool(const ThreadPool&) = delete;
+
+    /// Destructor. Complete the pending tasks and join the workers.
+    ~ThreadPool();
+
+    /// Submit a task to the pool.
+    /// \param[in] task Function to run on a worker thread.
+    /// \return Future receiving the result of the task, or its exception.
+    template <typename F>
+    auto Submit(F&& task) -> std::future<decltype(task())>
+    {
+        using R = decltype(task());
+        // std::function requires a copyable callable.
+        auto packagedTask = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+        std::future<R> result = packagedTask->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mTasks.push([packagedTask]() { (*packagedTask)(); });
+        }
+        mCondition.notify_one();
+        return result;
+    };
+
+    /// \brief Run a function over ranges of elements on the workers.
+    ///
+    /// [0, nbElements) is split in one contiguous range per worker, the
+    /// call returns once all ranges are processed. Must not be called
+    /// from a task of the same pool.
+    /// \param[in] nbElements Number of elements.
+    /// \param[in] fn Function called as fn(rangeId, first, last) for each
+    ///               range, rangeId is in [0, GetNbThreads()).
+    /// \throw The first exception thrown by fn, once all ranges are done.
+    template <typename F>
+    void ParallelFor(size_t nbElements, const F& fn)
+    {
+        const unsigned int nbRanges = GetNbThreads();
+        const size_t rangeSize = (nbElements + nbRanges - 1) / nbRanges;
+        std::vector<std::future<void>> ranges;
+        for(unsigned int range = 0; range < nbRanges; ++range)
+        {
+            const size_t first = std::min(nbElements, range * rangeSize);
+            const size_t last = std::min(nbElements, first + rangeSize);
+            ranges.push_back(Submit([&fn, range, first, last]() { fn(range, first, last); }));
+        }
+        // fn is referenced by every range, all must be done before throwing.
+        for(auto& range : ranges)
+        {
+            range.wait();
+        }
+        for(auto& range : ranges)
+        {
+            range.get();
+        }
+    };
+
+    /// Number of worker threads.
+    /// \return The number of worker threads.
+    inline unsigned int GetNbThreads() const { return static_cast<unsigned int>(mWorkers.size()); };
+
+private:
+    /// Loop run by each worker thread.
+    void workerLoop();
+
+    /// Worker threads.
+    std::vector<std::thread> mWorkers;
+
+    /// Tasks waiting for a worker.
+    std::queue<std::function<void()>> mTasks;
+
+    /// Mutex protecting the task queue.
+    std::mutex mMutex;
+
+    /// Condition signaled on new tasks and on termination.
+    std::condition_variable mCondition;
+
+    /// Are the workers asked to exit?
+    bool mIsTerminating;
+};
+} // namespace Utilities
+} // namespace Slicer
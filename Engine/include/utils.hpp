@@ -334,3 +334,32 @@ static inline glm::mat4 getTensorFromCoefficients(const std::vector<float>& coef
 
     return tensor;
 }
+
+// Returns false if the box is entirely outside of one of the clip planes
+// of the model-view-projection matrix mvp. Conservative: a box outside of
+// the frustum but crossing several clip planes is reported as visible.
+static inline bool isBoxInFrustum(const glm::mat4& mvp, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    int nbOutside[6] = {0, 0, 0, 0, 0, 0};
+    for(int i = 0; i < 8; ++i)
+    {
+        const glm::vec4 corner = mvp * glm::vec4((i & 1) ? boxMax.x : boxMin.x,
+                                                 (i & 2) ? boxMax.y : boxMin.y,
+                                                 (i & 4) ? boxMax.z : boxMin.z,
+                                                 1.0f);
+        nbOutside[0] += corner.x < -corner.w ? 1 : 0;
+        nbOutside[1] += corner.x > corner.w ? 1 : 0;
+        nbOutside[2] += corner.y < -corner.w ? 1 : 0;
+        nbOutside[3] += corner.y > corner.w ? 1 : 0;
+        nbOutside[4] += corner.z < -corner.w ? 1 : 0;
+        nbOutside[5] += corner.z > corner.w ? 1 : 0;
+    }
+    for(int plane = 0; plane < 6; ++plane)
+    {
+        if(nbOutside[plane] == 8)
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+/*
+Utilities and buffer objects for the level of detail of the glyphs.
+Must be included after camera_util.glsl, orthogrid_util.glsl and
+sphere_util.glsl.
+*/
+
+/// Same layout as DrawElementsIndirectCommand.
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    uint baseVertex;
+    uint baseInstance;
+};
+
+/// Draw command of each glyph, written by the level of detail pass.
+layout(std430, binding=26) buffer drawCommandsBuffer
+{
+    DrawCommand commands[];
+};
+
+/// Level of detail parameters buffer.
+layout(std430, binding=28) buffer lodInfoBuffer
+{
+    /// Height of the viewport, in pixels.
+    float viewportHeight;
+
+    /// Radius on screen, in pixels, up to which the coarsest level is used.
+    float levelZeroRadius;
+
+    /// Radius on screen, in pixels, under which glyphs are drawn as quads.
+    float aggregateRadius;
+
+    /// Number of levels of detail.
+    uint nbLevels;
+
+    /// Flat index of the first glyph of the pass.
+    uint firstSphere;
+
+    /// Number of glyphs of the pass.
+    uint nbSpheres;
+
+    /// Offset of the quad in the element buffer.
+    uint quadFirstIndex;
+};
+
+/// Number of element indices of the quad of an aggregated glyph.
+const uint QUAD_NB_INDICES = 6u;
+
+/// Get the radius on screen, in pixels, of the glyph of a voxel.
+/// Negative when the glyph is behind the camera.
+float getScreenRadius(mat4 model, ivec3 index3d)
+{
+    const vec4 center = model * vec4(vec3(index3d - gridDims.xyz / 2), 1.0f);
+    const vec4 clipCenter = projectionMatrix * viewMatrix * center;
+    if(clipCenter.w <= 0.0f)
+    {
+        return -1.0f;
+    }
+    return scaling * projectionMatrix[1][1] / clipCenter.w * viewportHeight * 0.5f;
+}
+
+/// Get the color encoding the peak direction of a glyph.
+vec4 getPeakColor(vec3 peakDirection)
+{
+    if(length(peakDirection) == 0.0f)
+    {
+        return vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+    return vec4(abs(normalize(peakDirection)), 1.0f);
+}
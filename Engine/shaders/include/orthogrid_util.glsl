@@ -22,10 +22,50 @@ layout(std430, binding=8) buffer gridInfoBuffer
     uint currentSlice;
 };
 
+/// Edge of the bricks of the bricked SH coeffs layout, in voxels.
+/// Must match BRICK_SIZE in nii_volume.h.
+const uint BRICK_SIZE = 8u;
+
+/// Interleave the bits of a voxel position inside its brick.
+uint getMortonCode(uvec3 position)
+{
+    uint code = 0u;
+    for(uint bit = 0u; (1u << bit) < BRICK_SIZE; ++bit)
+    {
+        code |= ((position.x >> bit) & 1u) << (3u * bit)
+              | ((position.y >> bit) & 1u) << (3u * bit + 1u)
+              | ((position.z >> bit) & 1u) << (3u * bit + 2u);
+    }
+    return code;
+}
+
+#ifdef SH_BRICK_CACHE
+/// Slot of each brick in the SH coeffs pool, by brick index. Only the
+/// bricks of the slices in use are resident.
+layout(std430, binding=29) buffer brickPageTableBuffer
+{
+    uint brickSlots[];
+};
+#endif
+
 /// Convert 3D grid index to flat index for accessing SH coeffs array.
+///
+/// With SH_LAYOUT_BRICKED, the voxels are stored by bricks of
+/// BRICK_SIZE^3 voxels, in Morton order inside each brick. With
+/// SH_BRICK_CACHE, the bricks are found through the page table.
 uint convertSHCoeffsIndex3DToFlatVoxID(uint i, uint j, uint k)
 {
+#ifdef SH_LAYOUT_BRICKED
+    const uvec3 nbBricks = (uvec3(gridDims.xyz) + BRICK_SIZE - 1u) / BRICK_SIZE;
+    const uvec3 brick = uvec3(i, j, k) / BRICK_SIZE;
+    uint brickID = (brick.z * nbBricks.y + brick.y) * nbBricks.x + brick.x;
+#ifdef SH_BRICK_CACHE
+    brickID = brickSlots[brickID];
+#endif
+    return brickID * BRICK_SIZE * BRICK_SIZE * BRICK_SIZE + getMortonCode(uvec3(i, j, k) % BRICK_SIZE);
+#else
     return k * gridDims.x * gridDims.y + j * gridDims.x + i;
+#endif
 }
 
 /// Get whether the current index inside the 3 slices of interest
@@ -79,6 +119,46 @@ ivec3 convertFlatOrthoSlicesIDTo3DVoxID(uint flatOrthoSlicesID)
     return ivec3(i, sliceIndex.y, k);
 }
 
+/// Side of the square tiles of voxels the planes are deformed by.
+const uint TILE_SIZE = 16u;
+
+/// Get the plane a flatOrthoSlicesID belongs to (0: X, 1: Y, 2: Z).
+uint getPlane(uint flatOrthoSlicesID)
+{
+    if(belongsToXSlice(flatOrthoSlicesID))
+    {
+        return 0u;
+    }
+    if(belongsToZSlice(flatOrthoSlicesID))
+    {
+        return 2u;
+    }
+    return 1u;
+}
+
+/// Get the grid axes along the rows and columns of a plane, in the
+/// order of the flat indices of the voxels of the plane.
+uvec2 getPlaneAxes(uint plane)
+{
+    if(plane == 0u)
+    {
+        return uvec2(2u, 1u);
+    }
+    if(plane == 1u)
+    {
+        return uvec2(0u, 2u);
+    }
+    return uvec2(0u, 1u);
+}
+
+/// Get the flat index of the tile of a plane containing a voxel.
+uint getTileIndex(uint plane, ivec3 index3d)
+{
+    const uvec2 axes = getPlaneAxes(plane);
+    const uint nbTilesU = (uint(gridDims[axes.x]) + TILE_SIZE - 1u) / TILE_SIZE;
+    return (uint(index3d[axes.y]) / TILE_SIZE) * nbTilesU + uint(index3d[axes.x]) / TILE_SIZE;
+}
+
 /// Get whether the view mode is 3D or not. The view mode is
 /// 3D when all slices are visible.
 bool is3DMode()
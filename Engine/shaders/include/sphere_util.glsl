@@ -50,3 +50,28 @@ layout(std430, binding=7) buffer sphereInfoBuffer
     /// Current color map. Default to 0 (Smooth Cool Warm).
     uint colorMap;
 };
+
+/*
+Compile-time specialization of the sphere parameters.
+Shader variants define these macros as constants, removing
+the runtime branches on the sphereInfo values.
+*/
+#ifndef NB_COEFFS
+#define NB_COEFFS nbCoeffs
+#endif
+
+#ifndef IS_NORMALIZED
+#define IS_NORMALIZED isNormalized
+#endif
+
+#ifndef FADE_IF_HIDDEN
+#define FADE_IF_HIDDEN fadeIfHidden
+#endif
+
+#ifndef COLOR_MAP_MODE
+#define COLOR_MAP_MODE colorMapMode
+#endif
+
+#ifndef COLOR_MAP
+#define COLOR_MAP colorMap
+#endif
@@ -70,7 +70,7 @@ out float fade_enabled;
 
 vec4 setColorMapMode(vec4 currentVertex, const uint voxID, const uint nbSpheres, const uint nbVoxels)
 {
-    if(colorMapMode == 0) // color by PDD
+    if(COLOR_MAP_MODE == 0) // color by PDD
     {
         vec4 pdd = allPdds[voxID + nbVoxels*(gl_DrawID/nbSpheres)];
         return abs(normalize(pdd));
@@ -84,34 +84,34 @@ vec4 setColorMapMode(vec4 currentVertex, const uint voxID, const uint nbSpheres,
         float ad = allADs[voxID + nbVoxels*(gl_DrawID/nbSpheres)];
         float rd = allRDs[voxID + nbVoxels*(gl_DrawID/nbSpheres)]; 
 
-        if(colorMapMode == 0)
+        if(COLOR_MAP_MODE == 0)
         {
             vec4 pdd = allPdds[voxID + nbVoxels*(gl_DrawID/nbSpheres)];
             return abs(normalize(pdd));
         }
-        else if(colorMapMode == 1)
+        else if(COLOR_MAP_MODE == 1)
         {
             idx = int(fa*32);
         }
-        else if(colorMapMode == 2)
+        else if(COLOR_MAP_MODE == 2)
         {
             idx = int(md*32);
         }
-        else if(colorMapMode == 3)
+        else if(COLOR_MAP_MODE == 3)
         {
             idx = int(ad*32);
         }
-        else if(colorMapMode == 4)
+        else if(COLOR_MAP_MODE == 4)
         {
             idx = int(rd*32);
         }
 
-        if (colorMap == 0) return vec4(smooth_cool_warm[ idx ], 1.0f);
-        if (colorMap == 1) return vec4(bent_cool_warm[ idx ], 1.0f);
-        if (colorMap == 2) return vec4(viridis[ idx ], 1.0f);
-        if (colorMap == 3) return vec4(plasma[ idx ], 1.0f);
-        if (colorMap == 4) return vec4(black_body[ idx ], 1.0f);
-        if (colorMap == 5) return vec4(inferno[ idx ], 1.0f);
+        if (COLOR_MAP == 0) return vec4(smooth_cool_warm[ idx ], 1.0f);
+        if (COLOR_MAP == 1) return vec4(bent_cool_warm[ idx ], 1.0f);
+        if (COLOR_MAP == 2) return vec4(viridis[ idx ], 1.0f);
+        if (COLOR_MAP == 3) return vec4(plasma[ idx ], 1.0f);
+        if (COLOR_MAP == 4) return vec4(black_body[ idx ], 1.0f);
+        if (COLOR_MAP == 5) return vec4(inferno[ idx ], 1.0f);
     }
 
     return abs(vec4(normalize(currentVertex.xyz), 1.0f));
@@ -159,5 +159,5 @@ void main()
     is_visible = getIsFlatOrthoSlicesIDVisible(gl_DrawID % nbSpheres) ? 1.0f : -1.0f;
     world_eye_pos = vec4(eye.xyz, 1.0f);
     vertex_slice = getVertexSlice(index3d);
-    fade_enabled = fadeIfHidden > 0 && is3DMode() ? 1.0 : -1.0;
+    fade_enabled = FADE_IF_HIDDEN > 0 && is3DMode() ? 1.0 : -1.0;
 }
@@ -17,9 +17,44 @@ layout(std430, binding=1) buffer allSpheresNormalsBuffer
     vec4 allNormals[];
 };
 
+/// Direction (xyz) and value (w) of the maximum amplitude of each sphere.
 layout(std430, binding=12) buffer allMaxAmplitudeBuffer
 {
-    float allMaxAmplitude[];
+    vec4 allMaxAmplitude[];
+};
+
+/// SH bands evaluated by the pass.
+layout(std430, binding=20) buffer deformationInfoBuffer
+{
+    /// First SH coefficient to evaluate.
+    uint firstCoeff;
+
+    /// Last SH coefficient (exclusive) to evaluate.
+    uint lastCoeff;
+};
+
+/// Radii evaluated for the coefficients before firstCoeff.
+layout(std430, binding=21) buffer previousRadiisBuffer
+{
+    float previousRadiis[];
+};
+
+/// Tiles of the plane to deform.
+layout(std430, binding=22) buffer tileListBuffer
+{
+    uint tileList[];
+};
+
+/// Normals of the radii of previousRadiis.
+layout(std430, binding=24) buffer previousSpheresNormalsBuffer
+{
+    vec4 previousNormals[];
+};
+
+/// Maximum amplitudes of the radii of previousRadiis.
+layout(std430, binding=25) buffer previousMaxAmplitudeBuffer
+{
+    vec4 previousMaxAmplitude[];
 };
 
 const float FLOAT_EPS = 1e-4;
@@ -31,21 +66,28 @@ bool scaleSphere(uint voxID, uint firstVertID)
     vec3 normal;
     float rmax;
     float maxAmplitude = 0.0f;
-    const float sh0 = shCoeffs[voxID * nbCoeffs];
+    vec3 peakDirection = vec3(0.0f);
+    const float sh0 = shCoeffs[voxID * NB_COEFFS];
     bool nonZero = sh0 > FLOAT_EPS;
     for(uint sphVertID = 0; sphVertID < nbVertices; ++sphVertID)
     {
         if(nonZero)
         {
-            sfEval = 0.0f;
-            for(int i = 0; i < nbCoeffs; ++i)
+            // Refinement passes add their bands to the previous radius.
+            sfEval = firstCoeff > 0 ? previousRadiis[firstVertID + sphVertID] : 0.0f;
+            for(uint i = firstCoeff; i < lastCoeff; ++i)
             {
-                sfEval += shCoeffs[voxID * nbCoeffs + i]
-                        * shFuncs[sphVertID * nbCoeffs + i];
+                sfEval += shCoeffs[voxID * NB_COEFFS + i]
+                        * shFuncs[sphVertID * NB_COEFFS + i];
             }
 
-            // Evaluate the max amplitude for all vertices.
-            maxAmplitude = max(maxAmplitude, sfEval);
+            // Evaluate the max amplitude for all vertices, and its
+            // direction for the aggregated color map.
+            if(sfEval > maxAmplitude)
+            {
+                maxAmplitude = sfEval;
+                peakDirection = vertices[sphVertID].xyz;
+            }
             
             allRadiis[firstVertID + sphVertID] = sfEval;
         }
@@ -56,7 +98,7 @@ bool scaleSphere(uint voxID, uint firstVertID)
     }
 
     maxAmplitude = maxAmplitude > 0.0f ? maxAmplitude : 1.0f;
-    allMaxAmplitude[firstVertID / nbVertices] = maxAmplitude;
+    allMaxAmplitude[firstVertID / nbVertices] = vec4(peakDirection, maxAmplitude);
 
     return nonZero;
 }
@@ -94,34 +136,62 @@ void updateNormals(uint firstNormalID)
     }
 }
 
+void copySphere(uint firstVertID)
+{
+    for(uint i = 0; i < nbVertices; ++i)
+    {
+        allRadiis[firstVertID + i] = previousRadiis[firstVertID + i];
+        allNormals[firstVertID + i] = previousNormals[firstVertID + i];
+    }
+    allMaxAmplitude[firstVertID / nbVertices] = previousMaxAmplitude[firstVertID / nbVertices];
+}
+
 void main()
 {
+    // One work group per voxel of a tile, one row of work groups per tile.
+    const uvec2 axes = getPlaneAxes(currentSlice);
+    const uvec2 planeSize = uvec2(gridDims[axes.x], gridDims[axes.y]);
+    const uint nbTilesU = (planeSize.x + TILE_SIZE - 1u) / TILE_SIZE;
+    const uint tile = tileList[gl_WorkGroupID.y];
+    const uint u = (tile % nbTilesU) * TILE_SIZE + gl_WorkGroupID.x % TILE_SIZE;
+    const uint v = (tile / nbTilesU) * TILE_SIZE + gl_WorkGroupID.x / TILE_SIZE;
+    if(u >= planeSize.x || v >= planeSize.y)
+    {
+        return;
+    }
+    const uint planeVoxID = v * planeSize.x + u;
+
     uint i, j, k, outSphereID;
     if(currentSlice == 0) // x-slice
     {
-        outSphereID = gl_GlobalInvocationID.x + gridDims.x * gridDims.y;
+        outSphereID = planeVoxID + gridDims.x * gridDims.y;
         i = sliceIndex.x;
-        j = gl_GlobalInvocationID.x / gridDims.z;
-        k = gl_GlobalInvocationID.x - j * gridDims.z;
+        j = planeVoxID / gridDims.z;
+        k = planeVoxID - j * gridDims.z;
     }
     else if(currentSlice == 1) // y-slice
     {
-        outSphereID = gl_GlobalInvocationID.x + gridDims.x * gridDims.y + gridDims.y * gridDims.z;
+        outSphereID = planeVoxID + gridDims.x * gridDims.y + gridDims.y * gridDims.z;
         j = sliceIndex.y;
-        k = gl_GlobalInvocationID.x / gridDims.x;
-        i = gl_GlobalInvocationID.x - k * gridDims.x;
+        k = planeVoxID / gridDims.x;
+        i = planeVoxID - k * gridDims.x;
     }
     else if(currentSlice == 2) // z-slice
     {
-        outSphereID = gl_GlobalInvocationID.x;
+        outSphereID = planeVoxID;
         k = sliceIndex.z;
-        j = gl_GlobalInvocationID.x / gridDims.x;
-        i = gl_GlobalInvocationID.x - j * gridDims.x;
+        j = planeVoxID / gridDims.x;
+        i = planeVoxID - j * gridDims.x;
     }
 
     const uint voxID = convertSHCoeffsIndex3DToFlatVoxID(i, j, k);
     const uint firstVertID = outSphereID * nbVertices;
-    if(scaleSphere(voxID, firstVertID))
+    if(firstCoeff == lastCoeff)
+    {
+        // The tile is already deformed in the front buffer.
+        copySphere(firstVertID);
+    }
+    else if(scaleSphere(voxID, firstVertID))
     {
         updateNormals(firstVertID);
     }
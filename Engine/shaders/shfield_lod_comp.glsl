@@ -0,0 +1,44 @@
+#version 460
+#extension GL_ARB_shading_language_include : require
+
+#include "/include/camera_util.glsl"
+#include "/include/orthogrid_util.glsl"
+#include "/include/sphere_util.glsl"
+#include "/include/lod_util.glsl"
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+layout(std430, binding=10) buffer modelTransformsBuffer
+{
+    mat4 modelMatrix;
+};
+
+/// Element count (x) and offset (y) of each level of detail, coarsest first.
+layout(std430, binding=27) buffer lodLevelsBuffer
+{
+    uvec2 levels[];
+};
+
+void main()
+{
+    if(gl_GlobalInvocationID.x >= nbSpheres)
+    {
+        return;
+    }
+    const uint sphereID = firstSphere + gl_GlobalInvocationID.x;
+
+    // Glyphs too small to be read, or behind the camera, are drawn as
+    // a quad colored by their peak direction.
+    const float radius = getScreenRadius(modelMatrix, convertFlatOrthoSlicesIDTo3DVoxID(sphereID));
+    if(radius < aggregateRadius)
+    {
+        commands[sphereID].count = QUAD_NB_INDICES;
+        commands[sphereID].firstIndex = quadFirstIndex;
+        return;
+    }
+
+    // Each level halves the length of the edges of the sphere.
+    const uint level = uint(clamp(ceil(log2(radius / levelZeroRadius)), 0.0f, float(nbLevels - 1u)));
+    commands[sphereID].count = levels[level].x;
+    commands[sphereID].firstIndex = levels[level].y;
+}
@@ -6,6 +6,7 @@
 #include "/include/orthogrid_util.glsl"
 #include "/include/sphere_util.glsl"
 #include "/include/vert_util.glsl"
+#include "/include/lod_util.glsl"
 
 layout(std430, binding=0) buffer allRadiisBuffer
 {
@@ -22,9 +23,17 @@ layout(std430, binding=10) buffer modelTransformsBuffer
     mat4 modelMatrix;
 };
 
+// Direction (xyz) and value (w) of the maximum amplitude of each sphere.
 layout(std430, binding=12) buffer allMaxAmplitudeBuffer
 {
-    float allMaxAmplitude[];
+    vec4 allMaxAmplitude[];
+};
+
+// Number of SH coefficients evaluated for each tile of the drawn plane,
+// 0 when the tile is not deformed.
+layout(std430, binding=23) buffer tileValidityBuffer
+{
+    uint tileNbCoeffs[];
 };
 
 // Outputs
@@ -50,7 +59,7 @@ out float fade_enabled;
 
 vec4 grayScaleColorMap()
 {   
-    const float maxAmplitude = allMaxAmplitude[gl_DrawID];
+    const float maxAmplitude = allMaxAmplitude[gl_BaseInstance].w;
     const float currentRadius = allRadiis[gl_VertexID];
     const vec4 grayScale = vec4(currentRadius/maxAmplitude, currentRadius/maxAmplitude, currentRadius/maxAmplitude, 1.0f);
     return grayScale;
@@ -58,7 +67,7 @@ vec4 grayScaleColorMap()
 
 vec4 setColorMapMode(vec4 currentVertex)
 {
-    if (colorMapMode == 1)
+    if (COLOR_MAP_MODE == 1)
     {
         return grayScaleColorMap();
     }
@@ -67,40 +76,73 @@ vec4 setColorMapMode(vec4 currentVertex)
 
 void main()
 {
-    const ivec3 index3d = convertFlatOrthoSlicesIDTo3DVoxID(gl_DrawID);
+    // Planes are drawn separately, the sphere index is stored in the
+    // base instance of the draw command.
+    const uint sphereID = uint(gl_BaseInstance);
+    const ivec3 index3d = convertFlatOrthoSlicesIDTo3DVoxID(sphereID);
+    const bool isDeformed = tileNbCoeffs[getTileIndex(getPlane(sphereID), index3d)] > 0u;
     const uint voxID = convertSHCoeffsIndex3DToFlatVoxID(index3d.x, index3d.y, index3d.z);
-    bool isAboveThreshold = shCoeffs[voxID * nbCoeffs] > sh0Threshold;
-
-    mat4 localMatrix;
-    localMatrix[0][0] = scaling;
-    localMatrix[1][1] = scaling;
-    localMatrix[2][2] = scaling;
-    localMatrix[3][0] = float(index3d.x - gridDims.x / 2);
-    localMatrix[3][1] = float(index3d.y - gridDims.y / 2);
-    localMatrix[3][2] = float(index3d.z - gridDims.z / 2);
-    localMatrix[3][3] = 1.0f;
-
-    const vec4 scaledVertice = vec4(vertices[gl_VertexID%nbVertices].xyz * allRadiis[gl_VertexID], 1.0f);
-    const float isNormalizedf= isNormalized > 0 ? 1.0f : 0.0f;
-    const float normalizationFactor = pow(1.0f/allMaxAmplitude[gl_DrawID], isNormalizedf);
-    const vec4 currentVertex = vec4(scaledVertice.xyz * normalizationFactor, 1.0f);
-
-    gl_Position = projectionMatrix
-                * viewMatrix
-                * modelMatrix
-                * localMatrix
-                * currentVertex;
-
-    world_frag_pos = modelMatrix
-                   * localMatrix
-                   * currentVertex;
-
-    world_normal = modelMatrix
-                 * allNormals[gl_VertexID];
-
-    color = setColorMapMode(scaledVertice);
-    is_visible = getIsFlatOrthoSlicesIDVisible(gl_DrawID) && isAboveThreshold ? 1.0f : -1.0f;
+    bool isAboveThreshold = shCoeffs[voxID * NB_COEFFS] > sh0Threshold;
+
+    const vec4 peakColor = getPeakColor(allMaxAmplitude[sphereID].xyz);
+    const uvec2 axes = getPlaneAxes(getPlane(sphereID));
+    const vec3 center = vec3(index3d - gridDims.xyz / 2);
+
+    // The level of detail pass draws glyphs smaller than a few pixels
+    // as a quad covering their voxel, colored by their peak direction.
+    if(commands[sphereID].count == QUAD_NB_INDICES)
+    {
+        const uint corner = gl_VertexID % nbVertices;
+        vec3 offset = vec3(0.0f);
+        offset[axes.x] = corner == 1u || corner == 2u ? 0.5f : -0.5f;
+        offset[axes.y] = corner >= 2u ? 0.5f : -0.5f;
+        vec4 normal = vec4(0.0f);
+        normal[getPlane(sphereID)] = 1.0f;
+
+        world_frag_pos = modelMatrix * vec4(center + offset, 1.0f);
+        gl_Position = projectionMatrix * viewMatrix * world_frag_pos;
+        world_normal = modelMatrix * normal;
+        color = peakColor;
+    }
+    else
+    {
+        mat4 localMatrix;
+        localMatrix[0][0] = scaling;
+        localMatrix[1][1] = scaling;
+        localMatrix[2][2] = scaling;
+        localMatrix[3][0] = float(index3d.x - gridDims.x / 2);
+        localMatrix[3][1] = float(index3d.y - gridDims.y / 2);
+        localMatrix[3][2] = float(index3d.z - gridDims.z / 2);
+        localMatrix[3][3] = 1.0f;
+
+        // Glyphs of tiles that are not deformed are collapsed and hidden.
+        const float radius = isDeformed ? allRadiis[gl_VertexID] : 0.0f;
+        const vec4 scaledVertice = vec4(vertices[gl_VertexID%nbVertices].xyz * radius, 1.0f);
+        const float normalizationFactor = IS_NORMALIZED > 0 ? 1.0f/allMaxAmplitude[sphereID].w : 1.0f;
+        const vec4 currentVertex = vec4(scaledVertice.xyz * normalizationFactor, 1.0f);
+
+        gl_Position = projectionMatrix
+                    * viewMatrix
+                    * modelMatrix
+                    * localMatrix
+                    * currentVertex;
+
+        world_frag_pos = modelMatrix
+                       * localMatrix
+                       * currentVertex;
+
+        world_normal = modelMatrix
+                     * allNormals[gl_VertexID];
+
+        color = setColorMapMode(scaledVertice);
+
+        // Glyphs fade from their peak color as they grow on screen.
+        const float blend = clamp(getScreenRadius(modelMatrix, index3d) / aggregateRadius - 1.0f, 0.0f, 1.0f);
+        color = mix(peakColor, color, blend);
+    }
+
+    is_visible = getIsFlatOrthoSlicesIDVisible(sphereID) && isAboveThreshold && isDeformed ? 1.0f : -1.0f;
     world_eye_pos = vec4(eye.xyz, 1.0f);
     vertex_slice = getVertexSlice(index3d);
-    fade_enabled = fadeIfHidden > 0 && is3DMode() ? 1.0 : -1.0;
+    fade_enabled = FADE_IF_HIDDEN > 0 && is3DMode() ? 1.0 : -1.0;
 }
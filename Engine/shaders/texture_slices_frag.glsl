@@ -0,0 +1,42 @@
+#version 460
+
+out vec4 shaded_color;
+
+in vec3 frag_tex_coord;
+
+in float is_visible;
+
+flat in int slice_id;
+
+// One 2D texture per plane, only the slices of interest are on the GPU.
+layout(binding=0) uniform sampler2D sliceTextureX;
+layout(binding=1) uniform sampler2D sliceTextureY;
+layout(binding=2) uniform sampler2D sliceTextureZ;
+
+const float DISCARD_EPSILON = 0.01f;
+
+// TODO: Move to SSBO, editable from application.
+const float OPACITY = 0.6f;
+
+void main()
+{
+    vec3 color;
+    if(slice_id == 0)
+    {
+        color = texture(sliceTextureX, frag_tex_coord.yz).xyz;
+    }
+    else if(slice_id == 1)
+    {
+        color = texture(sliceTextureY, frag_tex_coord.xz).xyz;
+    }
+    else
+    {
+        color = texture(sliceTextureZ, frag_tex_coord.xy).xyz;
+    }
+
+    shaded_color = vec4(color, OPACITY);
+    if(length(shaded_color.xyz) < DISCARD_EPSILON || is_visible < 0.0f)
+    {
+        discard;
+    }
+}
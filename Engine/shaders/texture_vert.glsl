@@ -18,6 +18,7 @@ out gl_PerVertex{
 };
 out vec3 frag_tex_coord;
 out float is_visible;
+flat out int slice_id;
 
 
 void main()
@@ -37,6 +38,7 @@ void main()
 
     if(slice.x > 0.9f && slice.x < 1.1f)
     {
+        slice_id = 0;
         frag_tex_coord = vec3(sliceIndex.x/float(gridDims.x-1.0f), texCoord.x, texCoord.y);
         direction = vec3(sliceIndex.x-ceil(gridDims.x/2.0f) + 0.5f, 0.0f, 0.0f);
         if(isSliceVisible.x == 1)
@@ -46,6 +48,7 @@ void main()
     }
     if(slice.y > 0.9f && slice.y < 1.1f)
     {
+        slice_id = 1;
         frag_tex_coord = vec3(texCoord.x, sliceIndex.y/float(gridDims.y-1.0f), texCoord.y);
         direction = vec3(0.0f,sliceIndex.y-ceil(gridDims.y/2.0f) + 0.5f ,0.0f);
         if(isSliceVisible.y == 1)
@@ -55,6 +58,7 @@ void main()
     }
     if(slice.z > 0.9f && slice.z < 1.1f)
     {
+        slice_id = 2;
         frag_tex_coord = vec3(texCoord.x, texCoord.y, sliceIndex.z/float(gridDims.z-1.0f));
         direction = vec3(0.0f, 0.0f, sliceIndex.z-ceil(gridDims.z/2.0f) + 0.5f);
         if(isSliceVisible.z == 1)
@@ -4,6 +4,14 @@
 #include <image.h>
 #include <nii_volume.h>
 #include <shader.h>
+#include <profiler.h>
+#include <benchmark.h>
+#include <memory_registry.h>
+#include <buffer.h>
+#include <stream_ring.h>
+#include <thread>
+#include <future>
+#include <algorithm>
 
 namespace
 {
@@ -15,12 +23,34 @@ const float TRANSLATION_SPEED = 0.02f;
 const float ROTATION_SPEED = 0.005f;
 const float ZOOM_SPEED = 1.0f;
 const float MAGNIFYING_MODE_ZOOM = 7.5f;
+// Frames rendered after a change, ImGui needs a few to settle.
+const int REDRAW_FRAME_COUNT = 3;
+// Maximum time waiting for events when idle, in seconds.
+const double IDLE_WAIT_TIMEOUT = 0.5;
+// Let the driver pick the number of shader compiler threads.
+const GLuint MAX_SHADER_COMPILER_THREADS = 0xFFFFFFFF;
+// Maximum number of images read and decoded concurrently.
+const unsigned int MAX_LOADING_THREADS = 8;
 const std::string WIN_TITLE = "dmri-explorer";
 const std::string GLSL_VERSION_STR = "#version 460";
 const std::string ICON16_FNAME = "/icons/icon16.png";
 const std::string ICON32_FNAME = "/icons/icon32.png";
 const std::string ICON48_FNAME = "/icons/icon48.png";
 const std::string ICON64_FNAME = "/icons/icon64.png";
+
+/// Is the asynchronous result available?
+template <typename T>
+bool isReady(const std::future<T>& future)
+{
+    return future.valid()
+        && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+/// Seconds elapsed since a time point.
+double secondsSince(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
 }
 
 namespace Slicer
@@ -31,6 +61,22 @@ Application::Application(const ArgumentParser& parser)
 ,mUI(nullptr)
 ,mScene(nullptr)
 ,mCursorPos(-1, -1)
+,mClicSecondaryViewport(false)
+,mIsSecondaryViewDirty(true)
+,mFramesToRender(REDRAW_FRAME_COUNT)
+,mLastFrameTime(std::chrono::steady_clock::now())
+,mStartTime(std::chrono::steady_clock::now())
+,mLoadingPool(nullptr)
+,mFODFImageLoad()
+,mTensorImageLoads()
+,mBackgroundImageLoad()
+,mNbStartupTasks(0)
+,mNbCompletedStartupTasks(0)
+,mIsMTFieldPending(false)
+,mIsSHFieldPending(false)
+,mIsTexturePending(false)
+,mBenchmarkPath(parser.GetBenchmarkPath())
+,mStartupEvents()
 {
     initApplicationState(parser);
     initialize();
@@ -38,6 +84,14 @@ Application::Application(const ArgumentParser& parser)
 
 Application::~Application()
 {
+    // GPU resources are released while the context is alive.
+    mScene.reset();
+    mCamera.reset();
+    mSecondaryCamera.reset();
+    mSecondaryFramebuffer.reset();
+    GPU::BufferArena::Instance().Clear();
+    GPU::StreamRing::Instance().Clear();
+
     mUI->Terminate();
     // GLFW cleanup
     glfwTerminate();
@@ -58,6 +112,8 @@ void Application::initialize()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Benchmarks render to a hidden window.
+    glfwWindowHint(GLFW_VISIBLE, mBenchmarkPath.empty() ? GLFW_TRUE : GLFW_FALSE);
 
     mWindow = glfwCreateWindow(WIN_WIDTH, WIN_HEIGHT, mTitle.c_str(), NULL, NULL);
     glfwMakeContextCurrent(mWindow);
@@ -70,6 +126,7 @@ void Application::initialize()
     glfwSetScrollCallback(mWindow, onMouseScroll);
     glfwSetWindowSizeCallback(mWindow, onWindowResize);
     glfwSetKeyCallback(mWindow, onPressSpace);
+    glfwSetWindowRefreshCallback(mWindow, onWindowRefresh);
 
     // Load all OpenGL functions using the glfw loader function
     if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
@@ -89,6 +146,17 @@ void Application::initialize()
         return;
     }
 
+    // Compile shaders on driver threads where supported. Shader
+    // compilation then overlaps the images still loading.
+    if(GLAD_GL_KHR_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsKHR(MAX_SHADER_COMPILER_THREADS);
+    }
+    else if(GLAD_GL_ARB_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsARB(MAX_SHADER_COMPILER_THREADS);
+    }
+
     // OpenGL render parameters
     glEnable(GL_SCISSOR_TEST);
     glEnable(GL_DEPTH_TEST);
@@ -96,19 +164,32 @@ void Application::initialize()
     glCullFace(GL_BACK);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glfwSwapInterval(0);
+    glfwSwapInterval(mState->Window.VSync.Get() ? 1 : 0);
+    mState->Window.VSync.RegisterCallback(
+        [this](bool p, bool n)
+        {
+            this->setVSync(p, n);
+        }
+    );
 
     mUI.reset(new UIManager(mWindow, GLSL_VERSION_STR, mState));
 
     const float aspectRatio = (float)WIN_WIDTH / (float)WIN_HEIGHT;
-    mCamera.reset(new Camera(glm::vec3(0.0f, 0.0f, 10.0f), // position
-                                glm::vec3(0.0f, 1.0f, 0.0f),  // upvector
-                                glm::vec3(0.0f, 0.0f, 0.0f),  //lookat
-                                glm::radians(60.0f), aspectRatio,
-                                0.1f, 500.0f,
-                                mState));
-
-    mSecondaryCamera.reset(new Camera(*mCamera));
+    {
+        Utilities::MemoryOwner owner("Camera");
+        mCamera.reset(new Camera(glm::vec3(0.0f, 0.0f, 10.0f), // position
+                                 glm::vec3(0.0f, 1.0f, 0.0f),  // upvector
+                                 glm::vec3(0.0f, 0.0f, 0.0f),  //lookat
+                                 glm::radians(60.0f), aspectRatio,
+                                 0.1f, 500.0f,
+                                 mState));
+        mSecondaryCamera.reset(new Camera(*mCamera));
+    }
+    {
+        Utilities::MemoryOwner owner("Magnifier");
+        mSecondaryFramebuffer.reset(new GPU::Framebuffer(WIN_WIDTH / SECONDARY_VIEWPORT_SCALE,
+                                                         WIN_HEIGHT / SECONDARY_VIEWPORT_SCALE));
+    }
 
     // Create the virtual filesystem for shader include directives.
     // Must be done before any ShaderProgram is instantiated.
@@ -116,34 +197,24 @@ void Application::initialize()
 
     mScene.reset(new Scene(mState));
 
-    // Render frame without the model
+    // Render frame without the model. Models are added by the main
+    // loop as their images finish loading.
+    glfwPollEvents();
     renderFrame();
+    recordStartupEvent("first_frame");
 
-    // Add MTfield once the UI is drawn
-    if (mState->TImages.IsInit())
-    {
-        mScene->AddMTField();
-    }
-
-    // Add SHfield once the UI is drawn
-    if (mState->FODFImage.IsInit())
-    {
-        mScene->AddSHField();
-    }
-
-    // Add texture once the UI is drawn
-    if(mState->BackgroundImage.IsInit())
-    {
-        mScene->AddTexture();
-    }
-
-    // Reset the secondary camera when magnifying mode is enabled from GUI
+    // Reset the secondary camera when magnifying mode is toggled. The
+    // callback is deferred, the zoom must be applied after the reset.
     mState->MagnifyingMode.RegisterCallback(
         [this](bool prev, bool next)
         {
             if (next != prev)
             {
                 mSecondaryCamera->ResetViewFromOther(*mCamera);
+                if(next)
+                {
+                    mSecondaryCamera->Zoom(MAGNIFYING_MODE_ZOOM);
+                }
             }
         }
     );
@@ -183,29 +254,66 @@ void Application::setWindowIcon()
 
 void Application::initApplicationState(const ArgumentParser& parser)
 {
-    // TODO: Check that loaded images have the same size
-    if (!parser.GetImagePath().empty())
-    {
-        mState->FODFImage.Update(NiftiImageWrapper<float>(parser.GetImagePath()));
-    }
-
-    if(!parser.GetBackgroundImagePath().empty())
+    // Images are read on worker threads while the window is created.
+    // Their dimensions are validated by the ArgumentParser. Each model
+    // adds its image loads and a model creation to the startup tasks.
+    const std::string imagePath = parser.GetImagePath();
+    const std::string backgroundPath = parser.GetBackgroundImagePath();
+    const std::vector<std::string>& tensorsPaths = parser.GetTensorsPath();
+    const unsigned int nbImages = static_cast<unsigned int>(tensorsPaths.size())
+                                + (imagePath.empty() ? 0 : 1)
+                                + (backgroundPath.empty() ? 0 : 1);
+    if(nbImages > 0)
     {
-        mState->BackgroundImage.Update(NiftiImageWrapper<float>(parser.GetBackgroundImagePath()));
+        const unsigned int nbThreads = std::min({nbImages, MAX_LOADING_THREADS,
+                                                 std::max(1u, std::thread::hardware_concurrency())});
+        mLoadingPool.reset(new Utilities::ThreadPool(nbThreads));
     }
 
-    const std::vector<std::string>& tensorsPaths = parser.GetTensorsPath();
+    // Tensor images come first, they define the voxel grid.
     if (tensorsPaths.size() > 0)
     {
-        std::vector<NiftiImageWrapper<float>> tensors(tensorsPaths.size());
-        for (int i=0; i < tensorsPaths.size(); i++)
+        for(const auto& path : tensorsPaths)
         {
-            tensors[i] = NiftiImageWrapper<float>(tensorsPaths[i]);
+            mTensorImageLoads.push_back(mLoadingPool->Submit(
+                [path]() { return NiftiImageWrapper<float>(path); }));
         }
-        mState->TImages.Update(tensors);
         mState->TensorFormat = parser.GetTensorFormat();
+        mNbStartupTasks += 2;
+        mIsMTFieldPending = true;
     }
 
+    if (!imagePath.empty())
+    {
+        // The cache streams whole bricks, it needs the bricked layout.
+        const bool isBricked = parser.GetBrickedSHLayout() || parser.GetSHCacheSize() > 0;
+        mFODFImageLoad = mLoadingPool->Submit(
+            [imagePath, isBricked]()
+            {
+                NiftiImageWrapper<float> image(imagePath);
+                if(isBricked)
+                {
+                    image.ConvertToBricks();
+                }
+                return image;
+            });
+        mNbStartupTasks += 2;
+        mIsSHFieldPending = true;
+    }
+
+    if(!backgroundPath.empty())
+    {
+        mBackgroundImageLoad = mLoadingPool->Submit(
+            [backgroundPath]() { return NiftiImageWrapper<float>(backgroundPath); });
+        mNbStartupTasks += 2;
+        mIsTexturePending = true;
+    }
+    mState->StreamBackground.Update(parser.GetStreamBackground());
+    mState->SHCacheSize.Update(parser.GetSHCacheSize());
+    mState->SHRank.Update(parser.GetSHRank());
+    mState->GenericShaders.Update(parser.GetGenericShaders());
+    mState->LoadingProgress.Update(mNbStartupTasks > 0 ? 0.0f : 1.0f);
+
     mState->Sphere.Resolution.Update(parser.GetSphereResolution());
     mState->Sphere.IsNormalized.Update(false);
     mState->Sphere.Scaling.Update(0.5f);
@@ -214,17 +322,6 @@ void Application::initApplicationState(const ArgumentParser& parser)
     mState->Sphere.ColorMapMode.Update(0);
     mState->Sphere.ColorMap.Update(0);
 
-    if (tensorsPaths.size()==0)
-    {    
-        mState->VoxelGrid.VolumeShape.Update(mState->FODFImage.Get().GetDims());
-    }
-    else
-    {
-        mState->VoxelGrid.VolumeShape.Update(mState->TImages.Get()[0].GetDims());
-    }
-    
-    mState->VoxelGrid.SliceIndices.Update(mState->VoxelGrid.VolumeShape.Get() / 2);
-
     mState->Window.Height.Update(WIN_HEIGHT);
     mState->Window.Width.Update(WIN_WIDTH);
     mState->Window.TranslationSpeed.Update(TRANSLATION_SPEED);
@@ -233,61 +330,355 @@ void Application::initApplicationState(const ArgumentParser& parser)
     mState->Window.SecondaryViewportScale.Update(SECONDARY_VIEWPORT_SCALE);
 
     mState->MagnifyingMode.Update(false);
+
+    mState->Window.ContinuousRendering.Update(parser.GetContinuousRendering());
+    mState->Window.MaxFPS.Update(parser.GetMaxFPS());
+    // Benchmarks are not limited by the display refresh rate.
+    mState->Window.VSync.Update(parser.GetVSync() && parser.GetBenchmarkPath().empty());
 }
 
-void Application::renderFrame()
+bool Application::pollStartupTasks()
 {
-    // Handle events
-    glfwPollEvents();
+    if(!mTensorImageLoads.empty()
+       && std::all_of(mTensorImageLoads.begin(), mTensorImageLoads.end(),
+                      isReady<NiftiImageWrapper<float>>))
+    {
+        std::vector<NiftiImageWrapper<float>> tensors;
+        for(auto& load : mTensorImageLoads)
+        {
+            tensors.push_back(load.get());
+        }
+        mTensorImageLoads.clear();
+        mState->TImages.Update(tensors);
+        completeStartupTask();
+        recordStartupEvent("tensor_images_loaded");
+    }
+    if(isReady(mFODFImageLoad))
+    {
+        mState->FODFImage.Update(mFODFImageLoad.get());
+        completeStartupTask();
+        recordStartupEvent("fodf_image_loaded");
+    }
+    if(isReady(mBackgroundImageLoad))
+    {
+        mState->BackgroundImage.Update(mBackgroundImageLoad.get());
+        completeStartupTask();
+        recordStartupEvent("background_image_loaded");
+    }
+
+    // The voxel grid is defined by the tensor images, else by the fODF
+    // image, and must be known before any model is created.
+    if(!mState->VoxelGrid.VolumeShape.IsInit())
+    {
+        if(mIsMTFieldPending)
+        {
+            if(!mState->TImages.IsInit())
+            {
+                return false;
+            }
+            mState->VoxelGrid.VolumeShape.Update(mState->TImages.Get()[0].GetDims());
+        }
+        else if(mIsSHFieldPending)
+        {
+            if(!mState->FODFImage.IsInit())
+            {
+                return false;
+            }
+            mState->VoxelGrid.VolumeShape.Update(mState->FODFImage.Get().GetDims());
+        }
+        else if(mIsTexturePending)
+        {
+            if(!mState->BackgroundImage.IsInit())
+            {
+                return false;
+            }
+            mState->VoxelGrid.VolumeShape.Update(mState->BackgroundImage.Get().GetDims());
+        }
+        mState->VoxelGrid.SliceIndices.Update(mState->VoxelGrid.VolumeShape.Get() / 2);
+        // Models read the grid at creation, they need no notification.
+        mState->UpdateQueue.Flush();
+    }
+
+    // Models are drawn in the order they are added, which is kept
+    // regardless of the order the images finish loading in. A single
+    // model is added per call so that a frame is drawn in between.
+    bool isAdded = false;
+    if(mIsMTFieldPending)
+    {
+        if(mState->TImages.IsInit())
+        {
+            mScene->AddMTField();
+            mIsMTFieldPending = false;
+            isAdded = true;
+        }
+    }
+    else if(mIsSHFieldPending)
+    {
+        if(mState->FODFImage.IsInit())
+        {
+            mScene->AddSHField();
+            mIsSHFieldPending = false;
+            isAdded = true;
+        }
+    }
+    else if(mIsTexturePending)
+    {
+        if(mState->BackgroundImage.IsInit())
+        {
+            mScene->AddTexture();
+            mIsTexturePending = false;
+            isAdded = true;
+        }
+    }
+
+    if(isAdded)
+    {
+        completeStartupTask();
+        if(!isLoading())
+        {
+            recordStartupEvent("scene_loaded");
+        }
+    }
+    return isAdded;
+}
 
+bool Application::isLoading() const
+{
+    return mNbCompletedStartupTasks < mNbStartupTasks;
+}
+
+void Application::recordStartupEvent(const std::string& name)
+{
+    const double seconds = secondsSince(mStartTime);
+    mStartupEvents.push_back(std::make_pair(name, seconds));
+    std::cout << "Startup event " << name << " (s): " << seconds << std::endl;
+}
+
+void Application::completeStartupTask()
+{
+    ++mNbCompletedStartupTasks;
+    mState->LoadingProgress.Update(static_cast<float>(mNbCompletedStartupTasks)
+                                 / static_cast<float>(mNbStartupTasks));
+}
+
+void Application::renderFrame()
+{
     Application* app = (Application*)glfwGetWindowUserPointer(mWindow);
     int h, w;
     int scaleFactor = app->mState->Window.SecondaryViewportScale.Get();
     bool magnifyingModeOn = app->mState->MagnifyingMode.Get();
     glfwGetWindowSize(mWindow, &w, &h);
+
+    // Queried before drawing, asynchronous work may complete during
+    // the main view draw and must then be seen in the secondary view.
+    const bool hasPendingUpdates = mScene->HasPendingUpdates();
+
     // Update camera parameters
     mCamera->UpdateGPU();
     glViewport(0, 0, w, h);
     glScissor(0, 0, w, h);
     // Draw scene
-    mScene->Render();
+    {
+        Utilities::ProfilerZone zone("Scene");
+        mScene->Render(*mCamera);
+    }
 
     if(magnifyingModeOn)
     {
-        mSecondaryCamera->UpdateGPU();
+        Utilities::ProfilerZone zone("Magnifier");
+        const int insetWidth = w / scaleFactor - 2 * SECONDARY_VIEWPORT_BORDER_WIDTH;
+        const int insetHeight = h / scaleFactor - 2 * SECONDARY_VIEWPORT_BORDER_WIDTH;
+
+        // The secondary viewport is only rendered again when its content
+        // changed, otherwise the cached image is copied.
+        const bool isResized = mSecondaryFramebuffer->Resize(insetWidth, insetHeight);
+        if(isResized || mIsSecondaryViewDirty || hasPendingUpdates)
+        {
+            mSecondaryFramebuffer->Bind();
+            mSecondaryCamera->UpdateGPU();
+            glViewport(0, 0, insetWidth, insetHeight);
+            glScissor(0, 0, insetWidth, insetHeight);
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            mScene->Render(*mSecondaryCamera);
+            GPU::Framebuffer::Unbind();
+            mIsSecondaryViewDirty = false;
+        }
+
         glViewport(0, 0, w / scaleFactor, h / scaleFactor);
         glScissor(0, 0, w / scaleFactor, h / scaleFactor);
         glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
-        glViewport(SECONDARY_VIEWPORT_BORDER_WIDTH,
-                   SECONDARY_VIEWPORT_BORDER_WIDTH,
-                   w / scaleFactor - 2 * SECONDARY_VIEWPORT_BORDER_WIDTH,
-                   h / scaleFactor - 2 * SECONDARY_VIEWPORT_BORDER_WIDTH);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
         glScissor(SECONDARY_VIEWPORT_BORDER_WIDTH,
                   SECONDARY_VIEWPORT_BORDER_WIDTH,
-                  w / scaleFactor - 2 * SECONDARY_VIEWPORT_BORDER_WIDTH,
-                  h / scaleFactor - 2 * SECONDARY_VIEWPORT_BORDER_WIDTH);
-        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-        mScene->Render();
+                  insetWidth, insetHeight);
+        mSecondaryFramebuffer->BlitToDefault(SECONDARY_VIEWPORT_BORDER_WIDTH,
+                                             SECONDARY_VIEWPORT_BORDER_WIDTH);
     }
 
     //Draw UI
-    mUI->DrawInterface();
+    {
+        Utilities::ProfilerZone zone("UI");
+        mUI->DrawInterface();
+    }
 
     glfwSwapBuffers(mWindow);
+
+    // Data pushed from here on goes to the region of the next frame.
+    GPU::StreamRing::Instance().EndFrame();
 }
 
 void Application::Run()
 {
+    if(!mBenchmarkPath.empty())
+    {
+        runBenchmark();
+        return;
+    }
+
+    // Camera and GPU updates are coalesced to once per frame. Input
+    // callbacks only update the camera on the CPU and parameter
+    // callbacks are called after event polling.
+    mState->UpdateQueue.SetDeferred(true);
     while (!glfwWindowShouldClose(mWindow))
     {
+        // Add the models whose images are loaded.
+        if(isLoading() && pollStartupTasks())
+        {
+            mIsSecondaryViewDirty = true;
+            requestRedraw();
+        }
+
+        // Handle events
+        if(isIdle())
+        {
+            // Nothing to draw, sleep until an event arrives.
+            glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT);
+        }
+        else
+        {
+            glfwPollEvents();
+        }
+
+        // Notify the parameters changed since the last frame, once each.
+        {
+            Utilities::ProfilerZone zone("Parameter updates");
+            if(mState->UpdateQueue.Flush())
+            {
+                // Any parameter may change the content of the secondary view.
+                mIsSecondaryViewDirty = true;
+                requestRedraw();
+            }
+        }
+
+        if(isIdle())
+        {
+            continue;
+        }
+
+        {
+            Utilities::ProfilerZone zone("Frame");
+            renderFrame();
+        }
+        Utilities::Profiler::Instance().EndFrame();
+        if(mFramesToRender > 0)
+        {
+            --mFramesToRender;
+        }
+        limitFrameRate();
+    }
+}
+
+void Application::runBenchmark()
+{
+    mState->UpdateQueue.SetDeferred(true);
+
+    // Frames drawn while the scene is loading are not measured.
+    while(isLoading() && !glfwWindowShouldClose(mWindow))
+    {
+        glfwPollEvents();
+        pollStartupTasks();
+        mState->UpdateQueue.Flush();
         renderFrame();
     }
+    if(!mState->VoxelGrid.VolumeShape.IsInit())
+    {
+        std::cerr << "Benchmark requires at least one image." << std::endl;
+        return;
+    }
+
+    Utilities::Profiler& profiler = Utilities::Profiler::Instance();
+    profiler.SetEnabled(true);
+    profiler.EndFrame();
+
+    Benchmark benchmark(mState);
+    for(size_t i = 0; i < benchmark.GetNbFrames(); ++i)
+    {
+        glfwPollEvents();
+        if(benchmark.PrepareFrame(i, *mCamera, *mSecondaryCamera))
+        {
+            mIsSecondaryViewDirty = true;
+        }
+
+        // Parameter callbacks, including deformation compute, are
+        // part of the frame.
+        benchmark.BeginFrame();
+        {
+            Utilities::ProfilerZone zone("Parameter updates");
+            if(mState->UpdateQueue.Flush())
+            {
+                mIsSecondaryViewDirty = true;
+            }
+        }
+        {
+            Utilities::ProfilerZone zone("Frame");
+            renderFrame();
+        }
+        benchmark.EndFrame();
+        profiler.EndFrame();
+    }
+
+    if(benchmark.WriteResults(mBenchmarkPath, mStartupEvents))
+    {
+        std::cout << "Benchmark results written to " << mBenchmarkPath << std::endl;
+    }
+}
+
+void Application::requestRedraw()
+{
+    mFramesToRender = REDRAW_FRAME_COUNT;
+}
+
+bool Application::isIdle() const
+{
+    // The progress bar is animated while loading.
+    return !mState->Window.ContinuousRendering.Get()
+        && !isLoading()
+        && mFramesToRender == 0
+        && !mScene->HasPendingUpdates();
+}
+
+void Application::limitFrameRate()
+{
+    const int maxFPS = mState->Window.MaxFPS.Get();
+    if(maxFPS > 0)
+    {
+        const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / maxFPS));
+        std::this_thread::sleep_until(mLastFrameTime + period);
+    }
+    mLastFrameTime = std::chrono::steady_clock::now();
+}
+
+void Application::setVSync(bool, bool vsync)
+{
+    glfwSwapInterval(vsync ? 1 : 0);
 }
 
 void Application::onMouseButton(GLFWwindow* window, int button, int action, int mod)
 {
     Application* app = (Application*)glfwGetWindowUserPointer(window);
+    app->requestRedraw();
     bool magnifyingModeOn = app->mState->MagnifyingMode.Get();
     int h, w;
     double xPos, yPos;
@@ -321,6 +712,7 @@ void Application::onMouseButton(GLFWwindow* window, int button, int action, int
 void Application::onMouseMove(GLFWwindow* window, double xPos, double yPos)
 {
     Application* app = (Application*)glfwGetWindowUserPointer(window);
+    app->requestRedraw();
     int h, w;
     glfwGetWindowSize(window, &w, &h);
     glfwGetCursorPos(window, &xPos, &yPos);
@@ -337,12 +729,11 @@ void Application::onMouseMove(GLFWwindow* window, double xPos, double yPos)
             if(app->mClicSecondaryViewport)
             {
                 app->mSecondaryCamera->RotateCS(glm::vec2(dx, dy));
-                app->mSecondaryCamera->UpdateGPU();
+                app->mIsSecondaryViewDirty = true;
             }
             else
             {
                 app->mCamera->RotateCS(glm::vec2(dx, dy));
-                app->mCamera->UpdateGPU();
             }
         }
         else if(app->mLastButton == GLFW_MOUSE_BUTTON_MIDDLE)
@@ -350,12 +741,11 @@ void Application::onMouseMove(GLFWwindow* window, double xPos, double yPos)
             if(app->mClicSecondaryViewport && app->mLastAction == GLFW_PRESS)
             {
                 app->mSecondaryCamera->TranslateCS(glm::vec2(dx, dy));
-                app->mSecondaryCamera->UpdateGPU();
+                app->mIsSecondaryViewDirty = true;
             }
             else
             {
                 app->mCamera->TranslateCS(glm::vec2(dx, dy));
-                app->mCamera->UpdateGPU();
             }
         }
     }
@@ -365,6 +755,7 @@ void Application::onMouseMove(GLFWwindow* window, double xPos, double yPos)
 void Application::onMouseScroll(GLFWwindow* window, double xoffset, double yoffset)
 {
     Application* app = (Application*)glfwGetWindowUserPointer(window);
+    app->requestRedraw();
     int h, w;
     int ratio = app->mState->Window.SecondaryViewportScale.Get();
     double xPos, yPos;
@@ -377,12 +768,11 @@ void Application::onMouseScroll(GLFWwindow* window, double xoffset, double yoffs
     if(app->insideSecondaryViewport(h, w, xPos, yPos) && app->mState->MagnifyingMode.Get())
     {
         app->mSecondaryCamera->Zoom(yoffset);
-        app->mSecondaryCamera->UpdateGPU();
+        app->mIsSecondaryViewDirty = true;
     }
     else
     {
         app->mCamera->Zoom(yoffset);
-        app->mCamera->UpdateGPU();
     }
 }
 
@@ -390,27 +780,32 @@ void Application::onWindowResize(GLFWwindow* window, int width, int height)
 {
     const float aspect = static_cast<float>(width) / static_cast<float>(height);
     Application* app = (Application*)glfwGetWindowUserPointer(window);
+    app->requestRedraw();
     const int scaleFactor = app->mState->Window.SecondaryViewportScale.Get();
 
     app->mCamera->Resize(aspect);
     app->mSecondaryCamera->Resize(aspect);
+    app->mIsSecondaryViewDirty = true;
     app->mState->Window.Width.Update(width);
     app->mState->Window.Height.Update(height);
 }
 
 void Application::onPressSpace(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+    Application* app = (Application*)glfwGetWindowUserPointer(window);
+    // Any key may edit an ImGui widget.
+    app->requestRedraw();
     if(action == GLFW_RELEASE && key == GLFW_KEY_SPACE)
     {
-        Application* app = (Application*)glfwGetWindowUserPointer(window);
+        // The secondary camera is reset by the MagnifyingMode callback.
         app->mState->MagnifyingMode.Update(!app->mState->MagnifyingMode.Get());
-        app->mSecondaryCamera->ResetViewFromOther(*app->mCamera);
-
-        if(app->mState->MagnifyingMode.Get())
-        {
-            app->mSecondaryCamera->Zoom(MAGNIFYING_MODE_ZOOM);
-        }
-        app->renderFrame();
+        app->mIsSecondaryViewDirty = true;
     }
 }
+
+void Application::onWindowRefresh(GLFWwindow* window)
+{
+    Application* app = (Application*)glfwGetWindowUserPointer(window);
+    app->requestRedraw();
+}
 } // namespace Slicer
\ No newline at end of file
@@ -1,9 +1,12 @@
 #include <application_state.h>
+#include <algorithm>
+#include <thread>
 
 namespace Slicer
 {
 ApplicationState::ApplicationState()
-:VoxelGrid()
+:UpdateQueue()
+,VoxelGrid()
 ,Sphere()
 ,Window()
 ,ViewMode()
@@ -11,6 +14,33 @@ ApplicationState::ApplicationState()
 ,FODFImage()
 ,TImages()
 ,BackgroundImage()
+,StreamBackground()
+,SHCacheSize()
+,SHRank()
+,GenericShaders()
+,LoadingProgress()
+,WorkerPool(new Utilities::ThreadPool(std::max(1u, std::thread::hardware_concurrency())))
 {
+    // Parameters edited interactively. Their callbacks can trigger
+    // GPU work and are coalesced to once per frame when deferred.
+    VoxelGrid.SliceIndices.AttachQueue(&UpdateQueue);
+    Sphere.Scaling.AttachQueue(&UpdateQueue);
+    Sphere.SH0Threshold.AttachQueue(&UpdateQueue);
+    Sphere.IsNormalized.AttachQueue(&UpdateQueue);
+    Sphere.Resolution.AttachQueue(&UpdateQueue);
+    Sphere.FadeIfHidden.AttachQueue(&UpdateQueue);
+    Sphere.ColorMapMode.AttachQueue(&UpdateQueue);
+    Sphere.ColorMap.AttachQueue(&UpdateQueue);
+    Window.Width.AttachQueue(&UpdateQueue);
+    Window.Height.AttachQueue(&UpdateQueue);
+    Window.SecondaryViewportScale.AttachQueue(&UpdateQueue);
+    Window.TranslationSpeed.AttachQueue(&UpdateQueue);
+    Window.RotationSpeed.AttachQueue(&UpdateQueue);
+    Window.ZoomSpeed.AttachQueue(&UpdateQueue);
+    Window.ContinuousRendering.AttachQueue(&UpdateQueue);
+    Window.MaxFPS.AttachQueue(&UpdateQueue);
+    Window.VSync.AttachQueue(&UpdateQueue);
+    ViewMode.Mode.AttachQueue(&UpdateQueue);
+    MagnifyingMode.AttachQueue(&UpdateQueue);
 }
 } // namespace Slicer
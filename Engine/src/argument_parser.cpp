@@ -1,7 +1,9 @@
 #include <argument_parser.h>
 #include <iostream>
 #include <string>
+#include <algorithm>
 #include <args/args.hxx>
+#include <nii_volume.h>
 
 namespace Slicer
 {
@@ -9,6 +11,7 @@ namespace
 {
 const int DEFAULT_SPHERE_RESOLUTION = 3;
 const std::string DEFAULT_TENSOR_FORMAT = "mrtrix";
+const int DEFAULT_MAX_FPS = 0;
 }
 
 ArgumentParser::ArgumentParser(int argc, char** argv)
@@ -16,6 +19,15 @@ ArgumentParser::ArgumentParser(int argc, char** argv)
 ,mBackgroundImagePath()
 ,mSphereResolution(DEFAULT_SPHERE_RESOLUTION)
 ,mTensorFormat(DEFAULT_TENSOR_FORMAT)
+,mStreamBackground(false)
+,mBrickedSHLayout(false)
+,mSHCacheSize(0)
+,mSHRank(0)
+,mContinuousRendering(false)
+,mMaxFPS(DEFAULT_MAX_FPS)
+,mVSync(false)
+,mGenericShaders(false)
+,mBenchmarkPath()
 {
     args::ArgumentParser parser("Those are the arguments available for dmriexplorer",
                                 "dmri-explorer - Real-time Diffusion MRI viewer.");
@@ -49,6 +61,51 @@ ArgumentParser::ArgumentParser(int argc, char** argv)
                                                 "Format of the coefficients in the tensor image: mrtrix (diagonal format), dipy (lower diagonal format), fsl (upper diagonal format). Default: mrtrix",
                                                 {'o', "tensor_format"});
 
+    args::Flag streamBackground(parser,
+                                "stream background",
+                                "Stream the background image one slice at a time instead of uploading the whole volume to the GPU. Recommended for high resolution backgrounds.",
+                                {"stream_background"});
+
+    args::ValueFlag<std::string> shLayout(parser,
+                                          "SH layout",
+                                          "Memory layout of the SH coefficients: linear (x-fastest) or bricked (8x8x8 bricks in Morton order, slices along all axes are read at the same speed). Default: linear.",
+                                          {"sh_layout"});
+
+    args::ValueFlag<int> shCacheSize(parser,
+                                     "SH cache size",
+                                     "Budget of the GPU cache of SH coefficients, in MiB. Only the bricks of the slices in use are kept on the GPU, implies --sh_layout bricked. Default: 0 (whole image on the GPU).",
+                                     {"sh_cache_mb"});
+
+    args::ValueFlag<int> shRank(parser,
+                                "SH rank",
+                                "Number of components of the low-rank basis the SH coefficients are compressed to. Each voxel keeps its first coefficient and one weight per component. Default: 0 (no compression).",
+                                {"sh_rank"});
+
+    args::Flag continuousRendering(parser,
+                                   "continuous rendering",
+                                   "Render frames continuously instead of only when the scene changes.",
+                                   {"continuous"});
+
+    args::ValueFlag<int> maxFPS(parser,
+                                "maximum frame rate",
+                                "Maximum number of frames rendered per second. Default: 0 (no limit).",
+                                {"max_fps"});
+
+    args::Flag vsync(parser,
+                     "vertical synchronization",
+                     "Synchronize frames with the display refresh rate.",
+                     {"vsync"});
+
+    args::Flag genericShaders(parser,
+                              "generic shaders",
+                              "Use generic shaders branching on the rendering options instead of specialized shader variants.",
+                              {"generic_shaders"});
+
+    args::ValueFlag<std::string> benchmarkPath(parser,
+                                               "benchmark output",
+                                               "Run a scripted benchmark in a hidden window and write the timings to this JSON file, then exit.",
+                                               {"benchmark"});
+
     try
     {
         parser.ParseCLI(argc, argv);
@@ -94,8 +151,106 @@ ArgumentParser::ArgumentParser(int argc, char** argv)
         // Optional argument, tensor ordering mode
         mTensorFormat = args::get(tensorFormat);
     }
+    if(streamBackground)
+    {
+        // Optional argument, background streaming mode
+        mStreamBackground = true;
+    }
+    if(shLayout)
+    {
+        // Optional argument, SH coefficients layout
+        const std::string layout = args::get(shLayout);
+        if(layout != "linear" && layout != "bricked")
+        {
+            std::cerr << "Unknown SH layout: " << layout << "." << std::endl;
+            mIsValid = false;
+            return;
+        }
+        mBrickedSHLayout = layout == "bricked";
+    }
+    if(shCacheSize)
+    {
+        // Optional argument, SH coefficients cache budget
+        mSHCacheSize = std::max(0, args::get(shCacheSize));
+    }
+    if(shRank)
+    {
+        // Optional argument, rank of the SH coefficients compression
+        mSHRank = std::max(0, args::get(shRank));
+    }
+    if(continuousRendering)
+    {
+        // Optional argument, continuous rendering
+        mContinuousRendering = true;
+    }
+    if(maxFPS)
+    {
+        // Optional argument, frame rate cap
+        mMaxFPS = std::max(0, args::get(maxFPS));
+    }
+    if(vsync)
+    {
+        // Optional argument, vertical synchronization
+        mVSync = true;
+    }
+    if(genericShaders)
+    {
+        // Optional argument, disable shader specialization
+        mGenericShaders = true;
+    }
+    if(benchmarkPath)
+    {
+        // Optional argument, benchmark mode
+        mBenchmarkPath = args::get(benchmarkPath);
+    }
+
+    mIsValid = validateImageDimensions();
+}
+
+bool ArgumentParser::validateImageDimensions() const
+{
+    // The background is sampled with normalized coordinates, it can have
+    // any resolution, e.g. a T1 image finer than the diffusion grid.
+    if(!mBackgroundImagePath.empty())
+    {
+        glm::ivec4 dims;
+        if(!NiftiImageWrapper<float>::ReadDims(mBackgroundImagePath, dims))
+        {
+            std::cerr << "Cannot read image header: " << mBackgroundImagePath << std::endl;
+            return false;
+        }
+    }
+
+    // The glyphs of the fODF and tensor images share the voxel grid.
+    std::vector<std::string> paths = mTensorsPath;
+    if(!mImagePath.empty())
+    {
+        paths.push_back(mImagePath);
+    }
 
-    mIsValid = true;
+    glm::ivec3 gridDims(0);
+    for(size_t i = 0; i < paths.size(); ++i)
+    {
+        glm::ivec4 dims;
+        if(!NiftiImageWrapper<float>::ReadDims(paths[i], dims))
+        {
+            std::cerr << "Cannot read image header: " << paths[i] << std::endl;
+            return false;
+        }
+        if(i == 0)
+        {
+            gridDims = glm::ivec3(dims);
+        }
+        else if(glm::ivec3(dims) != gridDims)
+        {
+            std::cerr << "Image dimensions mismatch: " << paths[i] << " is "
+                      << dims.x << "x" << dims.y << "x" << dims.z << ", expected "
+                      << gridDims.x << "x" << gridDims.y << "x" << gridDims.z
+                      << " (" << paths[0] << ")." << std::endl;
+            return false;
+        }
+    }
+    return true;
 }
 
 bool ArgumentParser::OK() const
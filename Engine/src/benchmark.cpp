@@ -0,0 +1,281 @@
+#include <benchmark.h>
+#include <profiler.h>
+#include <memory_registry.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <glm/gtc/constants.hpp>
+
+namespace Slicer
+{
+namespace
+{
+const size_t NB_WARMUP_FRAMES = 10;
+const size_t NB_ORBIT_FRAMES = 180;
+// Maximum number of slices visited along each axis.
+const size_t MAX_SLICE_STEPS = 64;
+const size_t NB_VIEW_MODE_FRAMES = 10;
+const size_t NB_MAGNIFIER_FRAMES = 30;
+const double NANOSECONDS_PER_MILLISECOND = 1.0e6;
+
+/// Escape a string for JSON output.
+std::string escape(const std::string& str)
+{
+    std::string escaped;
+    for(const char c : str)
+    {
+        if(c == '"' || c == '\\')
+        {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+}
+
+Benchmark::Benchmark(const std::shared_ptr<ApplicationState>& state)
+:mState(state)
+,mSteps()
+,mQueries()
+,mCPUTimes()
+,mFrameStart()
+{
+    // Cursor displacement for a full orbit over NB_ORBIT_FRAMES frames.
+    const float orbitStep = glm::two_pi<float>()
+                          / (static_cast<float>(NB_ORBIT_FRAMES)
+                          * mState->Window.RotationSpeed.Get());
+
+    addPhase("warmup", NB_WARMUP_FRAMES,
+        [](size_t, Camera&, Camera&) { return false; });
+
+    addPhase("orbit", NB_ORBIT_FRAMES,
+        [orbitStep](size_t, Camera& camera, Camera&)
+        {
+            camera.RotateCS(glm::vec2(orbitStep, 0.0f));
+            return false;
+        });
+
+    const glm::ivec3 shape = mState->VoxelGrid.VolumeShape.Get();
+    const glm::ivec3 center = mState->VoxelGrid.SliceIndices.Get();
+    const std::string sliceNames[3] = {"slice_x", "slice_y", "slice_z"};
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        const size_t nbSteps = std::min(MAX_SLICE_STEPS, static_cast<size_t>(shape[axis]));
+        addPhase(sliceNames[axis], nbSteps + 1,
+            [this, axis, nbSteps, shape, center](size_t i, Camera&, Camera&)
+            {
+                // The last frame restores the initial slice.
+                glm::ivec3 slices = center;
+                if(i < nbSteps)
+                {
+                    slices[axis] = static_cast<int>(i * shape[axis] / nbSteps);
+                }
+                mState->VoxelGrid.SliceIndices.Update(slices);
+                return false;
+            });
+    }
+
+    const State::CameraMode modes[4] = {State::CameraMode::projectiveX,
+                                        State::CameraMode::projectiveY,
+                                        State::CameraMode::projectiveZ,
+                                        State::CameraMode::projective3D};
+    const std::string modeNames[4] = {"view_x", "view_y", "view_z", "view_3d"};
+    for(int m = 0; m < 4; ++m)
+    {
+        const State::CameraMode mode = modes[m];
+        addPhase(modeNames[m], NB_VIEW_MODE_FRAMES,
+            [this, mode](size_t i, Camera&, Camera&)
+            {
+                if(i == 0)
+                {
+                    mState->ViewMode.Mode.Update(mode);
+                }
+                return false;
+            });
+    }
+
+    // The magnifier image is cached while only the main camera moves.
+    addPhase("magnifier_cached", NB_MAGNIFIER_FRAMES,
+        [this, orbitStep](size_t i, Camera& camera, Camera&)
+        {
+            if(i == 0)
+            {
+                mState->MagnifyingMode.Update(true);
+            }
+            camera.RotateCS(glm::vec2(orbitStep, 0.0f));
+            return false;
+        });
+
+    addPhase("magnifier_orbit", NB_MAGNIFIER_FRAMES,
+        [this, orbitStep](size_t i, Camera&, Camera& secondaryCamera)
+        {
+            secondaryCamera.RotateCS(glm::vec2(orbitStep, 0.0f));
+            if(i == NB_MAGNIFIER_FRAMES - 1)
+            {
+                mState->MagnifyingMode.Update(false);
+            }
+            return true;
+        });
+
+    mQueries.resize(mSteps.size());
+    glGenQueries(static_cast<GLsizei>(mQueries.size()), mQueries.data());
+    mCPUTimes.reserve(mSteps.size());
+}
+
+Benchmark::~Benchmark()
+{
+    glDeleteQueries(static_cast<GLsizei>(mQueries.size()), mQueries.data());
+}
+
+void Benchmark::addPhase(const std::string& phase, size_t nbFrames,
+                         const std::function<bool(size_t, Camera&, Camera&)>& apply)
+{
+    for(size_t i = 0; i < nbFrames; ++i)
+    {
+        Step step;
+        step.Phase = phase;
+        step.Apply = [apply, i](Camera& camera, Camera& secondaryCamera)
+        {
+            return apply(i, camera, secondaryCamera);
+        };
+        mSteps.push_back(step);
+    }
+}
+
+bool Benchmark::PrepareFrame(size_t frame, Camera& camera, Camera& secondaryCamera)
+{
+    return mSteps[frame].Apply(camera, secondaryCamera);
+}
+
+void Benchmark::BeginFrame()
+{
+    mFrameStart = std::chrono::steady_clock::now();
+    glBeginQuery(GL_TIME_ELAPSED, mQueries[mCPUTimes.size()]);
+}
+
+void Benchmark::EndFrame()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    mCPUTimes.push_back(std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - mFrameStart).count());
+}
+
+bool Benchmark::WriteResults(const std::string& path,
+                             const std::vector<std::pair<std::string, double>>& startupEvents)
+{
+    std::vector<double> gpuTimes(mCPUTimes.size());
+    for(size_t i = 0; i < gpuTimes.size(); ++i)
+    {
+        GLuint64 elapsed;
+        glGetQueryObjectui64v(mQueries[i], GL_QUERY_RESULT, &elapsed);
+        gpuTimes[i] = static_cast<double>(elapsed) / NANOSECONDS_PER_MILLISECOND;
+    }
+
+    std::ofstream file(path);
+    if(!file.is_open())
+    {
+        std::cerr << "Cannot write benchmark results to " << path << std::endl;
+        return false;
+    }
+
+    const GLubyte* renderer = glGetString(GL_RENDERER);
+    const glm::ivec3 shape = mState->VoxelGrid.VolumeShape.Get();
+    file << "{\n";
+    file << "  \"renderer\": \"" << escape(renderer ? (const char*)renderer : "") << "\",\n";
+    file << "  \"volume_shape\": [" << shape.x << ", " << shape.y << ", " << shape.z << "],\n";
+    file << "  \"window\": [" << mState->Window.Width.Get() << ", "
+         << mState->Window.Height.Get() << "],\n";
+
+    file << "  \"startup_s\": {";
+    for(size_t i = 0; i < startupEvents.size(); ++i)
+    {
+        file << (i == 0 ? "\n" : ",\n") << "    \"" << escape(startupEvents[i].first)
+             << "\": " << startupEvents[i].second;
+    }
+    file << "\n  },\n";
+
+    // Per phase summary, in script order.
+    std::vector<std::string> phases;
+    std::map<std::string, std::vector<size_t>> phaseFrames;
+    for(size_t i = 0; i < mCPUTimes.size(); ++i)
+    {
+        const std::string& phase = mSteps[i].Phase;
+        if(phaseFrames.find(phase) == phaseFrames.end())
+        {
+            phases.push_back(phase);
+        }
+        phaseFrames[phase].push_back(i);
+    }
+    file << "  \"phases\": [";
+    for(size_t p = 0; p < phases.size(); ++p)
+    {
+        const auto& frames = phaseFrames[phases[p]];
+        double cpuSum = 0.0, gpuSum = 0.0, cpuMax = 0.0, gpuMax = 0.0;
+        for(const size_t i : frames)
+        {
+            cpuSum += mCPUTimes[i];
+            gpuSum += gpuTimes[i];
+            cpuMax = std::max(cpuMax, mCPUTimes[i]);
+            gpuMax = std::max(gpuMax, gpuTimes[i]);
+        }
+        const double nbFrames = static_cast<double>(frames.size());
+        file << (p == 0 ? "\n" : ",\n")
+             << "    {\"name\": \"" << phases[p] << "\", \"frames\": " << frames.size()
+             << ", \"cpu_ms_mean\": " << cpuSum / nbFrames << ", \"cpu_ms_max\": " << cpuMax
+             << ", \"gpu_ms_mean\": " << gpuSum / nbFrames << ", \"gpu_ms_max\": " << gpuMax << "}";
+    }
+    file << "\n  ],\n";
+
+    // Per pass averages over the last frames of the script.
+    const auto& zoneStats = Utilities::Profiler::Instance().GetZoneStats();
+    file << "  \"passes\": [";
+    for(size_t z = 0; z < zoneStats.size(); ++z)
+    {
+        file << (z == 0 ? "\n" : ",\n")
+             << "    {\"name\": \"" << escape(zoneStats[z].Name) << "\", \"depth\": " << zoneStats[z].Depth
+             << ", \"cpu_ms_mean\": " << zoneStats[z].CPUAverage
+             << ", \"gpu_ms_mean\": " << zoneStats[z].GPUAverage << "}";
+    }
+    file << "\n  ],\n";
+
+    // Memory alive at the end of the script, largest allocations first.
+    using Kind = Utilities::MemoryRegistry::Kind;
+    const Utilities::MemoryRegistry& registry = Utilities::MemoryRegistry::Instance();
+    file << "  \"memory\": {\n";
+    const std::vector<std::pair<Kind, std::string>> kinds = {
+        {Kind::gpuBuffer, "gpu_buffer"}, {Kind::gpuTexture, "gpu_texture"}, {Kind::host, "host"}
+    };
+    for(const auto& kind : kinds)
+    {
+        file << "    \"" << kind.second << "_bytes\": " << registry.GetTotalBytes(kind.first)
+             << ", \"" << kind.second << "_peak_bytes\": " << registry.GetPeakBytes(kind.first) << ",\n";
+    }
+    const double time = registry.GetTime();
+    const auto entries = registry.GetLiveEntries();
+    file << "    \"allocations\": [";
+    for(size_t i = 0; i < entries.size(); ++i)
+    {
+        file << (i == 0 ? "\n" : ",\n")
+             << "      {\"owner\": \"" << escape(entries[i].Owner)
+             << "\", \"purpose\": \"" << escape(entries[i].Purpose)
+             << "\", \"kind\": \"" << Utilities::MemoryRegistry::ToString(entries[i].Type)
+             << "\", \"bytes\": " << entries[i].Bytes
+             << ", \"age_s\": " << time - entries[i].AllocationTime << "}";
+    }
+    file << "\n    ]\n";
+    file << "  },\n";
+
+    file << "  \"frames\": [";
+    for(size_t i = 0; i < mCPUTimes.size(); ++i)
+    {
+        file << (i == 0 ? "\n" : ",\n")
+             << "    {\"phase\": \"" << mSteps[i].Phase << "\", \"cpu_ms\": " << mCPUTimes[i]
+             << ", \"gpu_ms\": " << gpuTimes[i] << "}";
+    }
+    file << "\n  ]\n";
+    file << "}\n";
+    return true;
+}
+} // namespace Slicer
@@ -0,0 +1,84 @@
+#include <brick_cache.h>
+#include <stdexcept>
+
+namespace Slicer
+{
+namespace GPU
+{
+BrickCache::BrickCache()
+:mData(nullptr)
+,mNbValuesPerBrick(0)
+,mPageTable()
+,mSlotBricks()
+,mLeastRecentlyUsed()
+,mSlotPositions()
+,mNbRequests(0)
+,mSlotLastRequest()
+,mPoolData()
+,mPageTableData()
+{
+}
+
+BrickCache::BrickCache(const float* data, size_t nbValuesPerBrick, GLuint nbBricks,
+                       GLuint nbSlots, Binding poolBinding, Binding pageTableBinding)
+:mData(data)
+,mNbValuesPerBrick(nbValuesPerBrick)
+,mPageTable(nbBricks, INVALID_SLOT)
+,mSlotBricks(nbSlots, INVALID_SLOT)
+,mLeastRecentlyUsed()
+,mSlotPositions(nbSlots)
+,mNbRequests(0)
+,mSlotLastRequest(nbSlots, 0)
+,mPoolData(poolBinding, sizeof(float) * nbValuesPerBrick * nbSlots)
+,mPageTableData(mPageTable.data(), pageTableBinding, sizeof(GLuint) * mPageTable.size())
+{
+    for(GLuint slot = 0; slot < nbSlots; ++slot)
+    {
+        mSlotPositions[slot] = mLeastRecentlyUsed.insert(mLeastRecentlyUsed.end(), slot);
+    }
+}
+
+void BrickCache::MakeResident(const std::vector<GLuint>& bricks)
+{
+    ++mNbRequests;
+    bool isPageTableDirty = false;
+    for(const GLuint brick : bricks)
+    {
+        GLuint slot = mPageTable[brick];
+        if(slot == INVALID_SLOT)
+        {
+            // Evict the least recently used brick.
+            slot = mLeastRecentlyUsed.front();
+            if(mSlotLastRequest[slot] == mNbRequests)
+            {
+                throw std::runtime_error("BrickCache::MakeResident() exceeds the pool capacity.");
+            }
+            if(mSlotBricks[slot] != INVALID_SLOT)
+            {
+                mPageTable[mSlotBricks[slot]] = INVALID_SLOT;
+            }
+            mSlotBricks[slot] = brick;
+            mPageTable[brick] = slot;
+            const size_t brickSize = sizeof(float) * mNbValuesPerBrick;
+            mPoolData.Update(slot * brickSize, brickSize, mData + brick * mNbValuesPerBrick);
+            isPageTableDirty = true;
+        }
+
+        // The slot becomes the most recently used.
+        mLeastRecentlyUsed.splice(mLeastRecentlyUsed.end(), mLeastRecentlyUsed, mSlotPositions[slot]);
+        mSlotLastRequest[slot] = mNbRequests;
+    }
+
+    if(isPageTableDirty)
+    {
+        mPageTableData.Update(0, sizeof(GLuint) * mPageTable.size(), mPageTable.data());
+    }
+}
+
+void BrickCache::Bind()
+{
+    mPoolData.Bind();
+    mPageTableData.Bind();
+}
+} // namespace GPU
+} // namespace Slicer
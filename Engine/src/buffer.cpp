@@ -0,0 +1,212 @@
+#include <buffer.h>
+#include <memory_registry.h>
+#include <algorithm>
+
+namespace Slicer
+{
+namespace GPU
+{
+namespace
+{
+// Size of the blocks sub-allocated by the arena.
+const GLsizeiptr ARENA_BLOCK_SIZE = 64 * 1024 * 1024;
+}
+
+Buffer::Buffer()
+:mBuffer(0)
+,mSize(0)
+,mMemoryId(0)
+{
+}
+
+Buffer::Buffer(GLsizeiptr size, const void* data, GLbitfield flags)
+:mBuffer(0)
+,mSize(size)
+,mMemoryId(0)
+{
+    glCreateBuffers(1, &mBuffer);
+    glNamedBufferStorage(mBuffer, size, data, flags);
+}
+
+Buffer::Buffer(GLsizeiptr size, const void* data, GLbitfield flags, const std::string& purpose)
+:Buffer(size, data, flags)
+{
+    mMemoryId = Utilities::MemoryRegistry::Instance().Register(
+        Utilities::MemoryRegistry::Kind::gpuBuffer, purpose, static_cast<size_t>(size));
+}
+
+Buffer::Buffer(Buffer&& other) noexcept
+:mBuffer(other.mBuffer)
+,mSize(other.mSize)
+,mMemoryId(other.mMemoryId)
+{
+    other.mBuffer = 0;
+    other.mSize = 0;
+    other.mMemoryId = 0;
+}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept
+{
+    if(this != &other)
+    {
+        release();
+        std::swap(mBuffer, other.mBuffer);
+        std::swap(mSize, other.mSize);
+        std::swap(mMemoryId, other.mMemoryId);
+    }
+    return *this;
+}
+
+Buffer::~Buffer()
+{
+    release();
+}
+
+void Buffer::release()
+{
+    if(mBuffer != 0)
+    {
+        glDeleteBuffers(1, &mBuffer);
+        mBuffer = 0;
+    }
+    if(mMemoryId != 0)
+    {
+        Utilities::MemoryRegistry::Instance().Release(mMemoryId);
+        mMemoryId = 0;
+    }
+    mSize = 0;
+}
+
+BufferArena& BufferArena::Instance()
+{
+    static BufferArena arena;
+    return arena;
+}
+
+BufferArena::BufferArena()
+:mBlocks()
+,mAlignment(0)
+,mNbFreeBytes(0)
+,mFreeMemoryId(0)
+{
+}
+
+BufferRange BufferArena::Allocate(GLsizeiptr size)
+{
+    if(mAlignment == 0)
+    {
+        GLint alignment = 0;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        mAlignment = std::max<GLsizeiptr>(alignment, 4);
+    }
+    const GLsizeiptr alignedSize = getAlignedSize(size);
+
+    // First fit in the existing blocks.
+    for(auto& block : mBlocks)
+    {
+        for(auto it = block->FreeRanges.begin(); it != block->FreeRanges.end(); ++it)
+        {
+            if(it->second < alignedSize)
+            {
+                continue;
+            }
+            const GLintptr offset = it->first;
+            const GLsizeiptr remainder = it->second - alignedSize;
+            block->FreeRanges.erase(it);
+            if(remainder > 0)
+            {
+                block->FreeRanges[offset + alignedSize] = remainder;
+            }
+            updateFreeBytes(-alignedSize);
+            return {block->Storage.GetID(), offset, size};
+        }
+    }
+
+    // No room left, add a block.
+    const bool isDedicated = alignedSize > ARENA_BLOCK_SIZE;
+    const GLsizeiptr blockSize = isDedicated ? alignedSize : ARENA_BLOCK_SIZE;
+    std::unique_ptr<Block> block(new Block());
+    block->Storage = GPU::Buffer(blockSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    block->IsDedicated = isDedicated;
+    if(blockSize > alignedSize)
+    {
+        block->FreeRanges[alignedSize] = blockSize - alignedSize;
+    }
+    updateFreeBytes(blockSize - alignedSize);
+    const GLuint buffer = block->Storage.GetID();
+    mBlocks.push_back(std::move(block));
+    return {buffer, 0, size};
+}
+
+void BufferArena::Free(const BufferRange& range)
+{
+    if(range.Buffer == 0)
+    {
+        return;
+    }
+    auto blockIt = std::find_if(mBlocks.begin(), mBlocks.end(),
+                                [&range](const std::unique_ptr<Block>& block)
+                                { return block->Storage.GetID() == range.Buffer; });
+    if(blockIt == mBlocks.end())
+    {
+        return;
+    }
+    Block& block = **blockIt;
+    const GLsizeiptr alignedSize = getAlignedSize(range.Size);
+    updateFreeBytes(alignedSize);
+
+    if(block.IsDedicated)
+    {
+        updateFreeBytes(-block.Storage.GetSize());
+        mBlocks.erase(blockIt);
+        return;
+    }
+
+    // Insert the range and merge it with its free neighbours.
+    auto it = block.FreeRanges.emplace(range.Offset, alignedSize).first;
+    auto next = std::next(it);
+    if(next != block.FreeRanges.end() && it->first + it->second == next->first)
+    {
+        it->second += next->second;
+        block.FreeRanges.erase(next);
+    }
+    if(it != block.FreeRanges.begin())
+    {
+        auto previous = std::prev(it);
+        if(previous->first + previous->second == it->first)
+        {
+            previous->second += it->second;
+            block.FreeRanges.erase(it);
+        }
+    }
+}
+
+void BufferArena::Clear()
+{
+    mBlocks.clear();
+    updateFreeBytes(-mNbFreeBytes);
+}
+
+GLsizeiptr BufferArena::getAlignedSize(GLsizeiptr size) const
+{
+    const GLsizeiptr alignment = std::max<GLsizeiptr>(mAlignment, 1);
+    return std::max<GLsizeiptr>((size + alignment - 1) / alignment, 1) * alignment;
+}
+
+void BufferArena::updateFreeBytes(GLsizeiptr delta)
+{
+    mNbFreeBytes += delta;
+    auto& registry = Utilities::MemoryRegistry::Instance();
+    if(mFreeMemoryId == 0)
+    {
+        mFreeMemoryId = registry.Register(Utilities::MemoryRegistry::Kind::gpuBuffer,
+                                          "Buffer arena", "free space",
+                                          static_cast<size_t>(mNbFreeBytes));
+    }
+    else
+    {
+        registry.Resize(mFreeMemoryId, static_cast<size_t>(mNbFreeBytes));
+    }
+}
+} // namespace GPU
+} // namespace Slicer
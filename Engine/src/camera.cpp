@@ -4,6 +4,7 @@
 #include <glm/gtx/transform.hpp>
 #include <math.h>
 #include <application_state.h>
+#include <stream_ring.h>
 
 namespace Slicer
 {
@@ -20,7 +21,6 @@ Camera::Camera(const glm::vec3& position,
 ,mNear(near)
 ,mFar(far)
 ,mAspect(aspect)
-,mCamParamsData(GPU::Binding::camera)
 ,mState(state)
 {
     registerStateCallbacks();
@@ -37,7 +37,6 @@ Camera::Camera(const Camera& camera)
 ,mNear(camera.mNear)
 ,mFar(camera.mFar)
 ,mAspect(camera.mAspect)
-,mCamParamsData(camera.mCamParamsData)
 ,mState(camera.mState)
 ,mBlockRotation(camera.mBlockRotation)
 {
@@ -112,8 +111,7 @@ void Camera::UpdateGPU()
     cameraData.viewMatrix = mViewMatrix;
     cameraData.projectionMatrix = mProjectionMatrix;
 
-    mCamParamsData.Update(0, sizeof(CameraData), &cameraData);
-    mCamParamsData.ToGPU();
+    GPU::StreamRing::Instance().Bind(GPU::Binding::camera, &cameraData, sizeof(CameraData));
 }
 
 void Camera::Resize(const float& aspect)
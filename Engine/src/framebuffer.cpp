@@ -0,0 +1,118 @@
+#include <framebuffer.h>
+#include <memory_registry.h>
+#include <algorithm>
+
+namespace
+{
+// Bytes per pixel of the RGBA8 color and 24 bits depth attachments.
+const size_t BYTES_PER_PIXEL = 4 + 4;
+}
+
+namespace Slicer
+{
+namespace GPU
+{
+Framebuffer::Framebuffer()
+:mFBO(0)
+,mColorTexture(0)
+,mDepthRenderbuffer(0)
+,mWidth(0)
+,mHeight(0)
+,mOwner(Utilities::MemoryRegistry::Instance().GetCurrentOwner())
+,mMemoryId(0)
+{
+}
+
+Framebuffer::Framebuffer(int width, int height)
+:mFBO(0)
+,mColorTexture(0)
+,mDepthRenderbuffer(0)
+,mWidth(std::max(1, width))
+,mHeight(std::max(1, height))
+,mOwner(Utilities::MemoryRegistry::Instance().GetCurrentOwner())
+,mMemoryId(0)
+{
+    glCreateFramebuffers(1, &mFBO);
+    createAttachments();
+}
+
+Framebuffer::~Framebuffer()
+{
+    deleteAttachments();
+    if(mFBO != 0)
+    {
+        glDeleteFramebuffers(1, &mFBO);
+    }
+}
+
+bool Framebuffer::Resize(int width, int height)
+{
+    width = std::max(1, width);
+    height = std::max(1, height);
+    if(width == mWidth && height == mHeight)
+    {
+        return false;
+    }
+    mWidth = width;
+    mHeight = height;
+    deleteAttachments();
+    createAttachments();
+    return true;
+}
+
+void Framebuffer::Bind() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+}
+
+void Framebuffer::Unbind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Framebuffer::BlitToDefault(int x, int y) const
+{
+    glBlitNamedFramebuffer(mFBO, 0,
+                           0, 0, mWidth, mHeight,
+                           x, y, x + mWidth, y + mHeight,
+                           GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
+
+void Framebuffer::createAttachments()
+{
+    glCreateTextures(GL_TEXTURE_2D, 1, &mColorTexture);
+    glTextureStorage2D(mColorTexture, 1, GL_RGBA8, mWidth, mHeight);
+    glTextureParameteri(mColorTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(mColorTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glCreateRenderbuffers(1, &mDepthRenderbuffer);
+    glNamedRenderbufferStorage(mDepthRenderbuffer, GL_DEPTH_COMPONENT24, mWidth, mHeight);
+
+    glNamedFramebufferTexture(mFBO, GL_COLOR_ATTACHMENT0, mColorTexture, 0);
+    glNamedFramebufferRenderbuffer(mFBO, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepthRenderbuffer);
+
+    mMemoryId = Utilities::MemoryRegistry::Instance().Register(
+        Utilities::MemoryRegistry::Kind::gpuTexture, mOwner, "framebuffer attachments",
+        static_cast<size_t>(mWidth) * mHeight * BYTES_PER_PIXEL);
+}
+
+void Framebuffer::deleteAttachments()
+{
+    if(mColorTexture != 0)
+    {
+        glDeleteTextures(1, &mColorTexture);
+        mColorTexture = 0;
+    }
+    if(mDepthRenderbuffer != 0)
+    {
+        glDeleteRenderbuffers(1, &mDepthRenderbuffer);
+        mDepthRenderbuffer = 0;
+    }
+    if(mMemoryId != 0)
+    {
+        Utilities::MemoryRegistry::Instance().Release(mMemoryId);
+        mMemoryId = 0;
+    }
+}
+} // namespace GPU
+} // namespace Slicer
@@ -4,6 +4,20 @@
 #include <imgui_impl_opengl3.h>
 #include <model.h>
 #include <application_state.h>
+#include <algorithm>
+#include <profiler.h>
+#include <memory_registry.h>
+#include <cfloat>
+#include <cstdio>
+
+namespace
+{
+const double BYTES_PER_MEBIBYTE = 1024.0 * 1024.0;
+
+// Highest sphere resolution offered, each resolution has four times
+// more triangles than the previous one.
+const int MAX_SPHERE_RESOLUTION = 7;
+}
 
 namespace Slicer
 {
@@ -17,6 +31,8 @@ UIManager::UIManager()
 ,mShowSHOptions(false)
 ,mShowMTOptions(false)
 ,mShowPreferences(false)
+,mShowProfiler(false)
+,mShowMemory(false)
 {
 }
 
@@ -24,13 +40,15 @@ UIManager::UIManager(GLFWwindow* window, const std::string& glslVersion,
                      const std::shared_ptr<ApplicationState>& state)
 :mWindow(window)
 ,mIO(nullptr)
+,mState(state)
 ,mShowDemoWindow(false)
 ,mShowMagnifyingMode(false)
 ,mShowSlicers(false)
 ,mShowSHOptions(false)
 ,mShowMTOptions(false)
 ,mShowPreferences(false)
-,mState(state)
+,mShowProfiler(false)
+,mShowMemory(false)
 {
     // Initialize imgui
     IMGUI_CHECKVERSION();
@@ -64,6 +82,9 @@ void UIManager::DrawInterface()
     }
     drawPreferencesWindow();
     drawMagnifyingModeWindow();
+    drawLoadingWindow();
+    drawProfilerWindow();
+    drawMemoryWindow();
 
     // Rendering
     ImGui::Render();
@@ -99,6 +120,8 @@ void UIManager::drawMainMenuBar()
         }
         ImGui::MenuItem("Magnifying Mode", NULL, &mShowMagnifyingMode);
         ImGui::MenuItem("Preferences", NULL, &mShowPreferences);
+        ImGui::MenuItem("Profiler", NULL, &mShowProfiler);
+        ImGui::MenuItem("Memory", NULL, &mShowMemory);
         ImGui::Separator();
         ImGui::MenuItem("Show demo window", NULL, &mShowDemoWindow);
         ImGui::EndMenu();
@@ -152,6 +175,147 @@ void UIManager::drawMagnifyingModeWindow()
     ImGui::End();
 }
 
+void UIManager::drawLoadingWindow()
+{
+    if(!mState->LoadingProgress.IsInit() || mState->LoadingProgress.Get() >= 1.0f)
+        return;
+
+    const ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration
+                                 | ImGuiWindowFlags_AlwaysAutoResize
+                                 | ImGuiWindowFlags_NoSavedSettings
+                                 | ImGuiWindowFlags_NoFocusOnAppearing
+                                 | ImGuiWindowFlags_NoNav;
+    const ImVec2 viewportSize = ImGui::GetMainViewport()->Size;
+    ImGui::SetNextWindowPos(ImVec2(viewportSize.x * 0.5f, viewportSize.y - 10.f),
+                            ImGuiCond_Always, ImVec2(0.5f, 1.0f));
+    ImGui::Begin("Loading", nullptr, flags);
+    ImGui::Text("Loading images...");
+    ImGui::ProgressBar(mState->LoadingProgress.Get(), ImVec2(300.f, 0.f));
+    ImGui::End();
+}
+
+void UIManager::drawProfilerWindow()
+{
+    Utilities::Profiler& profiler = Utilities::Profiler::Instance();
+    static bool wasProfilerShown = false;
+    if(mShowProfiler != wasProfilerShown)
+    {
+        profiler.SetEnabled(mShowProfiler);
+        wasProfilerShown = mShowProfiler;
+    }
+    if(!mShowProfiler)
+        return;
+
+    ImGui::SetNextWindowPos(ImVec2(5.f, 25.f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(420.f, 360.f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowCollapsed(false, ImGuiCond_FirstUseEver);
+
+    ImGui::Begin("Profiler", &mShowProfiler);
+    const auto& allStats = profiler.GetZoneStats();
+
+    // Rolling frame time graphs.
+    for(const auto& stats : allStats)
+    {
+        if(stats.Name != "Frame" || stats.Depth != 0)
+            continue;
+
+        char overlay[32];
+        snprintf(overlay, sizeof(overlay), "CPU %.2f ms", stats.CPUAverage);
+        ImGui::PlotLines("##cpuframe", stats.CPUHistory.data(),
+                         static_cast<int>(stats.CPUHistory.size()), 0,
+                         overlay, 0.0f, FLT_MAX, ImVec2(0.f, 60.f));
+        snprintf(overlay, sizeof(overlay), "GPU %.2f ms", stats.GPUAverage);
+        ImGui::PlotLines("##gpuframe", stats.GPUHistory.data(),
+                         static_cast<int>(stats.GPUHistory.size()), 0,
+                         overlay, 0.0f, FLT_MAX, ImVec2(0.f, 60.f));
+    }
+
+    // Per pass breakdown, averaged over the last frames.
+    if(ImGui::BeginTable("##zones", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+    {
+        ImGui::TableSetupColumn("Pass");
+        ImGui::TableSetupColumn("CPU (ms)");
+        ImGui::TableSetupColumn("GPU (ms)");
+        ImGui::TableHeadersRow();
+        for(const auto& stats : allStats)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%*s%s", 2 * stats.Depth, "", stats.Name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.CPUAverage);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", stats.GPUAverage);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
+void UIManager::drawMemoryWindow()
+{
+    if(!mShowMemory)
+        return;
+
+    ImGui::SetNextWindowPos(ImVec2(5.f, 25.f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(520.f, 360.f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowCollapsed(false, ImGuiCond_FirstUseEver);
+
+    ImGui::Begin("Memory", &mShowMemory);
+    using Kind = Utilities::MemoryRegistry::Kind;
+    const Utilities::MemoryRegistry& registry = Utilities::MemoryRegistry::Instance();
+
+    // Totals, alive and highest, per kind of memory.
+    for(const Kind kind : {Kind::gpuBuffer, Kind::gpuTexture, Kind::host})
+    {
+        ImGui::Text("%-12s %9.2f MiB (peak %.2f MiB)",
+                    Utilities::MemoryRegistry::ToString(kind),
+                    registry.GetTotalBytes(kind) / BYTES_PER_MEBIBYTE,
+                    registry.GetPeakBytes(kind) / BYTES_PER_MEBIBYTE);
+    }
+
+    // Allocations alive, largest first.
+    const double time = registry.GetTime();
+    if(ImGui::BeginTable("##allocations", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV |
+                                             ImGuiTableFlags_ScrollY, ImVec2(0.f, 200.f)))
+    {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Owner");
+        ImGui::TableSetupColumn("Purpose");
+        ImGui::TableSetupColumn("Kind");
+        ImGui::TableSetupColumn("Size (MiB)");
+        ImGui::TableSetupColumn("Age (s)");
+        ImGui::TableHeadersRow();
+        for(const auto& entry : registry.GetLiveEntries())
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(entry.Owner.c_str());
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(entry.Purpose.c_str());
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(Utilities::MemoryRegistry::ToString(entry.Type));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", entry.Bytes / BYTES_PER_MEBIBYTE);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", time - entry.AllocationTime);
+        }
+        ImGui::EndTable();
+    }
+
+    // Most recent releases, with the lifetime of the allocation.
+    if(ImGui::CollapsingHeader("Released"))
+    {
+        for(const auto& entry : registry.GetReleasedEntries())
+        {
+            ImGui::Text("%s / %s: %.3f MiB, lived %.1f s", entry.Owner.c_str(),
+                        entry.Purpose.c_str(), entry.Bytes / BYTES_PER_MEBIBYTE,
+                        entry.ReleaseTime - entry.AllocationTime);
+        }
+    }
+    ImGui::End();
+}
+
 void UIManager::drawPreferencesWindow()
 {
     if(!mShowPreferences)
@@ -180,6 +344,26 @@ void UIManager::drawPreferencesWindow()
     {
         mState->Window.ZoomSpeed.Update(zoomSpeed);
     }
+
+    ImGui::Separator();
+    bool continuousRendering = mState->Window.ContinuousRendering.Get();
+    bool vsync = mState->Window.VSync.Get();
+    int maxFPS = mState->Window.MaxFPS.Get();
+
+    if(ImGui::Checkbox("Continuous rendering", &continuousRendering))
+    {
+        mState->Window.ContinuousRendering.Update(continuousRendering);
+    }
+
+    if(ImGui::Checkbox("Vertical sync", &vsync))
+    {
+        mState->Window.VSync.Update(vsync);
+    }
+
+    if(ImGui::InputInt("Max FPS (0: no limit)", &maxFPS, 5, 30))
+    {
+        mState->Window.MaxFPS.Update(std::max(0, maxFPS));
+    }
     ImGui::End();
 }
 
@@ -307,8 +491,10 @@ void UIManager::drawSHOptionsWindow()
     auto& normalizedParam = mState->Sphere.IsNormalized;
     auto& fadeHiddenParam = mState->Sphere.FadeIfHidden;
     auto& colorMapModeParam = mState->Sphere.ColorMapMode;
+    auto& resolutionParam = mState->Sphere.Resolution;
     if(!scalingParam.IsInit() || !thresholdParam.IsInit() ||
-        !normalizedParam.IsInit() || !fadeHiddenParam.IsInit())
+        !normalizedParam.IsInit() || !fadeHiddenParam.IsInit() ||
+        !resolutionParam.IsInit())
     {
         ImGui::Spacing();
         ImGui::End();
@@ -320,6 +506,7 @@ void UIManager::drawSHOptionsWindow()
     bool normalized = normalizedParam.Get();
     bool fadeIfHidden = fadeHiddenParam.Get();
     int colorMapMode = colorMapModeParam.Get();
+    int resolution = resolutionParam.Get();
 
     ImGui::Text("Sphere scaling");
     ImGui::SameLine();
@@ -333,6 +520,12 @@ void UIManager::drawSHOptionsWindow()
     {
         thresholdParam.Update(threshold);
     }
+    ImGui::Text("Sphere resolution");
+    ImGui::SameLine();
+    if(ImGui::InputInt("##sphere.resolution", &resolution, 1, 1))
+    {
+        resolutionParam.Update(std::min(std::max(resolution, 0), MAX_SPHERE_RESOLUTION));
+    }
     if(ImGui::Checkbox("##sphere.normalized", &normalized))
     {
         normalizedParam.Update(normalized);
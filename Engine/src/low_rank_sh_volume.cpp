@@ -0,0 +1,250 @@
+#include <low_rank_sh_volume.h>
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+
+namespace
+{
+/// Voxels whose first coefficient is below are empty, they are never
+/// deformed. Must match FLOAT_EPS in shfield_comp.glsl.
+const float EMPTY_SH0 = 1e-4f;
+
+/// The eigen decomposition stops when the off-diagonal norm falls
+/// below this fraction of the matrix norm.
+const double JACOBI_TOLERANCE = 1e-12;
+const int JACOBI_MAX_SWEEPS = 50;
+
+/// Eigen decomposition of a symmetric matrix with the cyclic Jacobi method.
+/// \param[in,out] matrix Row-major n x n matrix, diagonalized in place.
+/// \param[in] n Size of the matrix.
+/// \return Eigenvectors, as the columns of a row-major n x n matrix.
+std::vector<double> diagonalize(std::vector<double>& matrix, size_t n)
+{
+    std::vector<double> vectors(n * n, 0.0);
+    for(size_t i = 0; i < n; ++i)
+    {
+        vectors[i * n + i] = 1.0;
+    }
+    const double norm = std::inner_product(matrix.begin(), matrix.end(), matrix.begin(), 0.0);
+
+    for(int sweep = 0; sweep < JACOBI_MAX_SWEEPS; ++sweep)
+    {
+        double offDiagonal = 0.0;
+        for(size_t p = 0; p < n; ++p)
+        {
+            for(size_t q = p + 1; q < n; ++q)
+            {
+                offDiagonal += 2.0 * matrix[p * n + q] * matrix[p * n + q];
+            }
+        }
+        if(offDiagonal <= JACOBI_TOLERANCE * norm)
+        {
+            break;
+        }
+
+        for(size_t p = 0; p < n; ++p)
+        {
+            for(size_t q = p + 1; q < n; ++q)
+            {
+                const double apq = matrix[p * n + q];
+                if(apq == 0.0)
+                {
+                    continue;
+                }
+
+                // Rotation zeroing the (p, q) element.
+                const double theta = (matrix[q * n + q] - matrix[p * n + p]) / (2.0 * apq);
+                const double t = (theta >= 0.0 ? 1.0 : -1.0)
+                               / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                const double c = 1.0 / std::sqrt(t * t + 1.0);
+                const double s = t * c;
+                for(size_t k = 0; k < n; ++k)
+                {
+                    const double akp = matrix[k * n + p];
+                    const double akq = matrix[k * n + q];
+                    matrix[k * n + p] = c * akp - s * akq;
+                    matrix[k * n + q] = s * akp + c * akq;
+                }
+                for(size_t k = 0; k < n; ++k)
+                {
+                    const double apk = matrix[p * n + k];
+                    const double aqk = matrix[q * n + k];
+                    matrix[p * n + k] = c * apk - s * aqk;
+                    matrix[q * n + k] = s * apk + c * aqk;
+                }
+                for(size_t k = 0; k < n; ++k)
+                {
+                    const double vkp = vectors[k * n + p];
+                    const double vkq = vectors[k * n + q];
+                    vectors[k * n + p] = c * vkp - s * vkq;
+                    vectors[k * n + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+    return vectors;
+}
+}
+
+namespace Slicer
+{
+LowRankSHVolume::LowRankSHVolume(const NiftiImageWrapper<float>& image, unsigned int rank,
+                                 Utilities::ThreadPool& pool)
+:mNbCoeffs(image.GetDims().w)
+,mNbVoxels(image.GetVoxelData().size() / image.GetDims().w)
+,mRank(std::min(rank, static_cast<unsigned int>(image.GetDims().w) - 1))
+,mComponents()
+,mValues()
+,mRelativeError(0.0)
+,mValuesMemory()
+{
+    const auto& data = image.GetVoxelData();
+    computeComponents(data, pool);
+    compress(data, pool);
+}
+
+void LowRankSHVolume::computeComponents(const std::vector<float>& data, Utilities::ThreadPool& pool)
+{
+    const unsigned int nbThreads = pool.GetNbThreads();
+    // The second moment matrix is not centered, an empty anisotropic
+    // part stays empty once compressed.
+    const size_t n = mNbCoeffs - 1;
+    std::vector<std::vector<double>> moments(nbThreads);
+    pool.ParallelFor(mNbVoxels,
+        [&](unsigned int t, size_t begin, size_t end)
+        {
+            std::vector<double> moment(n * n, 0.0);
+            for(size_t v = begin; v < end; ++v)
+            {
+                const float* coeffs = &data[v * mNbCoeffs];
+                if(!(coeffs[0] > EMPTY_SH0))
+                {
+                    continue;
+                }
+                for(size_t i = 0; i < n; ++i)
+                {
+                    const double ci = coeffs[i + 1];
+                    for(size_t j = i; j < n; ++j)
+                    {
+                        moment[i * n + j] += ci * coeffs[j + 1];
+                    }
+                }
+            }
+            moments[t].swap(moment);
+        });
+
+    std::vector<double> moment(n * n, 0.0);
+    for(unsigned int t = 0; t < nbThreads; ++t)
+    {
+        for(size_t i = 0; i < n; ++i)
+        {
+            for(size_t j = i; j < n; ++j)
+            {
+                moment[i * n + j] += moments[t][i * n + j];
+                moment[j * n + i] = moment[i * n + j];
+            }
+        }
+    }
+
+    // Components by decreasing eigenvalue.
+    const std::vector<double> vectors = diagonalize(moment, n);
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&](size_t a, size_t b) { return moment[a * n + a] > moment[b * n + b]; });
+    mComponents.resize(mRank * n);
+    for(unsigned int i = 0; i < mRank; ++i)
+    {
+        for(size_t c = 0; c < n; ++c)
+        {
+            mComponents[i * n + c] = static_cast<float>(vectors[c * n + order[i]]);
+        }
+    }
+}
+
+void LowRankSHVolume::compress(const std::vector<float>& data, Utilities::ThreadPool& pool)
+{
+    const unsigned int nbThreads = pool.GetNbThreads();
+    const size_t n = mNbCoeffs - 1;
+    const size_t nbValuesPerVoxel = GetNbValuesPerVoxel();
+    mValues.assign(mNbVoxels * nbValuesPerVoxel, 0.0f);
+    mValuesMemory = Utilities::MemoryRecord(Utilities::MemoryRegistry::Instance().GetCurrentOwner(),
+                                            "low-rank SH coefficients",
+                                            mValues.size() * sizeof(float));
+
+    std::vector<double> residuals(nbThreads, 0.0);
+    std::vector<double> norms(nbThreads, 0.0);
+    pool.ParallelFor(mNbVoxels,
+        [&](unsigned int t, size_t begin, size_t end)
+        {
+            std::vector<double> reconstruction(n);
+            double residual = 0.0;
+            double norm = 0.0;
+            for(size_t v = begin; v < end; ++v)
+            {
+                const float* coeffs = &data[v * mNbCoeffs];
+                float* values = &mValues[v * nbValuesPerVoxel];
+                values[0] = coeffs[0];
+                if(!(coeffs[0] > EMPTY_SH0))
+                {
+                    continue;
+                }
+
+                std::fill(reconstruction.begin(), reconstruction.end(), 0.0);
+                for(unsigned int i = 0; i < mRank; ++i)
+                {
+                    const float* component = &mComponents[i * n];
+                    double weight = 0.0;
+                    for(size_t c = 0; c < n; ++c)
+                    {
+                        weight += static_cast<double>(component[c]) * coeffs[c + 1];
+                    }
+                    values[i + 1] = static_cast<float>(weight);
+                    for(size_t c = 0; c < n; ++c)
+                    {
+                        reconstruction[c] += weight * component[c];
+                    }
+                }
+
+                norm += static_cast<double>(coeffs[0]) * coeffs[0];
+                for(size_t c = 0; c < n; ++c)
+                {
+                    const double difference = coeffs[c + 1] - reconstruction[c];
+                    residual += difference * difference;
+                    norm += static_cast<double>(coeffs[c + 1]) * coeffs[c + 1];
+                }
+            }
+            residuals[t] = residual;
+            norms[t] = norm;
+        });
+
+    const double residual = std::accumulate(residuals.begin(), residuals.end(), 0.0);
+    const double norm = std::accumulate(norms.begin(), norms.end(), 0.0);
+    mRelativeError = norm > 0.0 ? std::sqrt(residual / norm) : 0.0;
+}
+
+std::vector<float> LowRankSHVolume::ProjectSHFunctions(const std::vector<float>& shFuncs) const
+{
+    const size_t n = mNbCoeffs - 1;
+    const size_t nbValuesPerVoxel = GetNbValuesPerVoxel();
+    const size_t nbVertices = shFuncs.size() / mNbCoeffs;
+    std::vector<float> projected(nbVertices * nbValuesPerVoxel);
+    for(size_t vertex = 0; vertex < nbVertices; ++vertex)
+    {
+        const float* funcs = &shFuncs[vertex * mNbCoeffs];
+        float* values = &projected[vertex * nbValuesPerVoxel];
+        values[0] = funcs[0];
+        for(unsigned int i = 0; i < mRank; ++i)
+        {
+            const float* component = &mComponents[i * n];
+            double value = 0.0;
+            for(size_t c = 0; c < n; ++c)
+            {
+                value += static_cast<double>(component[c]) * funcs[c + 1];
+            }
+            values[i + 1] = static_cast<float>(value);
+        }
+    }
+    return projected;
+}
+} // namespace Slicer
@@ -0,0 +1,231 @@
+#include <memory_registry.h>
+#include <algorithm>
+#include <utility>
+
+namespace Slicer
+{
+namespace Utilities
+{
+namespace
+{
+// Number of released allocations kept for display.
+const size_t RELEASED_HISTORY_SIZE = 64;
+const char* UNKNOWN_OWNER = "Unknown";
+
+// Owner scopes of the calling thread, innermost last.
+thread_local std::vector<std::string> ownerStack;
+}
+
+MemoryRegistry& MemoryRegistry::Instance()
+{
+    static MemoryRegistry registry;
+    return registry;
+}
+
+const char* MemoryRegistry::ToString(Kind kind)
+{
+    switch(kind)
+    {
+    case Kind::gpuBuffer:
+        return "GPU buffer";
+    case Kind::gpuTexture:
+        return "GPU texture";
+    case Kind::host:
+        return "Host";
+    }
+    return "";
+}
+
+MemoryRegistry::MemoryRegistry()
+:mStartTime(std::chrono::steady_clock::now())
+,mMutex()
+,mNextId(1)
+,mLiveEntries()
+,mReleasedEntries()
+,mTotalBytes()
+,mPeakBytes()
+{
+}
+
+size_t MemoryRegistry::Register(Kind kind, const std::string& purpose, size_t bytes)
+{
+    return Register(kind, GetCurrentOwner(), purpose, bytes);
+}
+
+size_t MemoryRegistry::Register(Kind kind, const std::string& owner,
+                                const std::string& purpose, size_t bytes)
+{
+    const double time = GetTime();
+    std::lock_guard<std::mutex> lock(mMutex);
+    const size_t id = mNextId++;
+    mLiveEntries[id] = {id, kind, owner, purpose, bytes, time, -1.0};
+    mTotalBytes[kind] += bytes;
+    mPeakBytes[kind] = std::max(mPeakBytes[kind], mTotalBytes[kind]);
+    return id;
+}
+
+void MemoryRegistry::Resize(size_t id, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mLiveEntries.find(id);
+    if(it == mLiveEntries.end())
+    {
+        return;
+    }
+    Entry& entry = it->second;
+    mTotalBytes[entry.Type] = mTotalBytes[entry.Type] - entry.Bytes + bytes;
+    mPeakBytes[entry.Type] = std::max(mPeakBytes[entry.Type], mTotalBytes[entry.Type]);
+    entry.Bytes = bytes;
+}
+
+void MemoryRegistry::Release(size_t id)
+{
+    const double time = GetTime();
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mLiveEntries.find(id);
+    if(it == mLiveEntries.end())
+    {
+        return;
+    }
+    Entry entry = it->second;
+    mLiveEntries.erase(it);
+    mTotalBytes[entry.Type] -= entry.Bytes;
+
+    entry.ReleaseTime = time;
+    if(mReleasedEntries.size() == RELEASED_HISTORY_SIZE)
+    {
+        mReleasedEntries.erase(mReleasedEntries.begin());
+    }
+    mReleasedEntries.push_back(entry);
+}
+
+std::string MemoryRegistry::GetCurrentOwner() const
+{
+    return ownerStack.empty() ? UNKNOWN_OWNER : ownerStack.back();
+}
+
+std::vector<MemoryRegistry::Entry> MemoryRegistry::GetLiveEntries() const
+{
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for(const auto& it : mLiveEntries)
+        {
+            entries.push_back(it.second);
+        }
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const Entry& a, const Entry& b) { return a.Bytes > b.Bytes; });
+    return entries;
+}
+
+std::vector<MemoryRegistry::Entry> MemoryRegistry::GetReleasedEntries() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return std::vector<Entry>(mReleasedEntries.rbegin(), mReleasedEntries.rend());
+}
+
+size_t MemoryRegistry::GetTotalBytes(Kind kind) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mTotalBytes.find(kind);
+    return it == mTotalBytes.end() ? 0 : it->second;
+}
+
+size_t MemoryRegistry::GetPeakBytes(Kind kind) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mPeakBytes.find(kind);
+    return it == mPeakBytes.end() ? 0 : it->second;
+}
+
+double MemoryRegistry::GetTime() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - mStartTime).count();
+}
+
+void MemoryRegistry::pushOwner(const std::string& owner)
+{
+    ownerStack.push_back(owner);
+}
+
+void MemoryRegistry::popOwner()
+{
+    ownerStack.pop_back();
+}
+
+MemoryOwner::MemoryOwner(const std::string& owner)
+{
+    MemoryRegistry::Instance().pushOwner(owner);
+}
+
+MemoryOwner::~MemoryOwner()
+{
+    MemoryRegistry::Instance().popOwner();
+}
+
+MemoryRecord::MemoryRecord()
+:mId(0)
+,mOwner()
+,mPurpose()
+,mBytes(0)
+{
+}
+
+MemoryRecord::MemoryRecord(const std::string& owner, const std::string& purpose, size_t bytes)
+:mId(MemoryRegistry::Instance().Register(MemoryRegistry::Kind::host, owner, purpose, bytes))
+,mOwner(owner)
+,mPurpose(purpose)
+,mBytes(bytes)
+{
+}
+
+MemoryRecord::MemoryRecord(const MemoryRecord& other)
+:mId(0)
+,mOwner(other.mOwner)
+,mPurpose(other.mPurpose)
+,mBytes(other.mBytes)
+{
+    if(other.mId != 0)
+    {
+        mId = MemoryRegistry::Instance().Register(MemoryRegistry::Kind::host,
+                                                  mOwner, mPurpose, mBytes);
+    }
+}
+
+MemoryRecord::MemoryRecord(MemoryRecord&& other) noexcept
+:mId(other.mId)
+,mOwner(std::move(other.mOwner))
+,mPurpose(std::move(other.mPurpose))
+,mBytes(other.mBytes)
+{
+    other.mId = 0;
+}
+
+MemoryRecord::~MemoryRecord()
+{
+    if(mId != 0)
+    {
+        MemoryRegistry::Instance().Release(mId);
+    }
+}
+
+MemoryRecord& MemoryRecord::operator=(MemoryRecord other) noexcept
+{
+    std::swap(mId, other.mId);
+    std::swap(mOwner, other.mOwner);
+    std::swap(mPurpose, other.mPurpose);
+    std::swap(mBytes, other.mBytes);
+    return *this;
+}
+
+void MemoryRecord::Resize(size_t bytes)
+{
+    mBytes = bytes;
+    if(mId != 0)
+    {
+        MemoryRegistry::Instance().Resize(mId, bytes);
+    }
+}
+} // namespace Utilities
+} // namespace Slicer
@@ -1,5 +1,6 @@
 #include <model.h>
 #include <utils.hpp>
+#include <stream_ring.h>
 #include <iostream>
 #include <stdexcept>
 
@@ -7,7 +8,7 @@ namespace Slicer
 {
 Model::Model(const std::shared_ptr<ApplicationState>& state)
 :mState(state)
-,mTransformGPUData(GPU::Binding::modelTransform)
+,mModelViewProjection(1.0f)
 ,mCoordinateSystem()
 ,mIsInit(false)
 {
@@ -25,7 +26,7 @@ void Model::initializeModel()
     mIsInit = true;
 }
 
-void Model::Draw()
+void Model::Draw(const glm::mat4& viewProjection)
 {
     if(!mIsInit)
     {
@@ -34,6 +35,7 @@ void Model::Draw()
     mProgramPipeline.Bind();
 
     uploadTransformToGPU();
+    mModelViewProjection = viewProjection * mCoordinateSystem->ToWorld();
 
     drawSpecific();
 
@@ -44,8 +46,7 @@ void Model::Draw()
 void Model::uploadTransformToGPU()
 {
     glm::mat4 transform = mCoordinateSystem->ToWorld();
-    mTransformGPUData.Update(0, sizeof(glm::mat4), &transform);
-    mTransformGPUData.ToGPU();
+    GPU::StreamRing::Instance().Bind(GPU::Binding::modelTransform, &transform, sizeof(glm::mat4));
 }
 
 void Model::resetCS(std::shared_ptr<CoordinateSystem> cs)
@@ -1,4 +1,7 @@
 #include <mt_field.h>
+#include <profiler.h>
+#include <memory_registry.h>
+#include <stream_ring.h>
 #include <glad/glad.h>
 #include <timer.h>
 #include <cmath>
@@ -20,8 +23,8 @@ MTField::MTField(const std::shared_ptr<ApplicationState>& state,
 ,mNbSpheresZ(0)
 ,mIsSliceDirty(true)
 ,mVAO(0)
-,mIndicesBO(0)
-,mIndirectBO(0)
+,mIndicesBO()
+,mIndirectBO()
 ,mTensorValuesData()
 ,mCoefsValuesData()
 ,mPddsValuesData()
@@ -35,6 +38,7 @@ MTField::MTField(const std::shared_ptr<ApplicationState>& state,
 ,mAllSpheresNormalsData()
 ,mIndirectCmd()
 ,mSphere(nullptr)
+,mDrawCommandsMemory()
 {
     resetCS(std::shared_ptr<CoordinateSystem>(new CoordinateSystem(glm::mat4(1.0f), parent)));
     initializeModel();
@@ -46,6 +50,10 @@ MTField::MTField(const std::shared_ptr<ApplicationState>& state,
 
 MTField::~MTField()
 {
+    if(mVAO != 0)
+    {
+        glDeleteVertexArrays(1, &mVAO);
+    }
 }
 
 void MTField::updateApplicationStateAtInit()
@@ -94,13 +102,38 @@ void MTField::registerStateCallbacks()
 
 void MTField::initProgramPipeline()
 {
-    const std::string vsPath = DMRI_EXPLORER_BINARY_DIR + std::string("/shaders/mtfield_vert.glsl");
     const std::string fsPath = DMRI_EXPLORER_BINARY_DIR + std::string("/shaders/mtfield_frag.glsl");
+    mFragmentShader = GPU::ShaderProgram(fsPath, GL_FRAGMENT_SHADER);
+    updateProgramPipeline();
+}
+
+void MTField::updateProgramPipeline()
+{
+    // Key 0 is the generic variant, reading the state at runtime.
+    unsigned int key = 0;
+    std::vector<std::string> defines;
+    if(!mState->GenericShaders.Get())
+    {
+        const unsigned int colorMapMode = mState->Sphere.ColorMapMode.Get();
+        // The color map is only read when coloring by tensor metrics.
+        const unsigned int colorMap = colorMapMode == 0 ? 0 : mState->Sphere.ColorMap.Get();
+        const unsigned int fadeIfHidden = mState->Sphere.FadeIfHidden.Get() ? 1 : 0;
+        key = 1 + (colorMapMode | colorMap << 4 | fadeIfHidden << 8);
+        defines.push_back("COLOR_MAP_MODE " + std::to_string(colorMapMode) + "u");
+        defines.push_back("COLOR_MAP " + std::to_string(colorMap) + "u");
+        defines.push_back("FADE_IF_HIDDEN " + std::to_string(fadeIfHidden) + "u");
+    }
 
-    std::vector<GPU::ShaderProgram> shaders;
-    shaders.push_back(GPU::ShaderProgram(vsPath, GL_VERTEX_SHADER));
-    shaders.push_back(GPU::ShaderProgram(fsPath, GL_FRAGMENT_SHADER));
-    mProgramPipeline = GPU::ProgramPipeline(shaders);
+    auto variant = mPipelineVariants.find(key);
+    if(variant == mPipelineVariants.end())
+    {
+        const std::string vsPath = DMRI_EXPLORER_BINARY_DIR + std::string("/shaders/mtfield_vert.glsl");
+        std::vector<GPU::ShaderProgram> shaders;
+        shaders.push_back(GPU::ShaderProgram(vsPath, GL_VERTEX_SHADER, defines));
+        shaders.push_back(mFragmentShader);
+        variant = mPipelineVariants.emplace(key, GPU::ProgramPipeline(shaders)).first;
+    }
+    mProgramPipeline = variant->second;
 }
 
 void MTField::initializeMembers()
@@ -141,8 +174,12 @@ void MTField::initializeMembers()
 
     // Bind primitives to GPU
     glCreateVertexArrays(1, &mVAO);
-    mIndicesBO = genVBO<GLuint>(mIndices);
-    mIndirectBO = genVBO<DrawElementsIndirectCommand>(mIndirectCmd);
+    mIndicesBO = GPU::Buffer(mIndices.size() * sizeof(GLuint), mIndices.data(), 0, "indices");
+    mIndirectBO = GPU::Buffer(mIndirectCmd.size() * sizeof(DrawElementsIndirectCommand),
+                              mIndirectCmd.data(), 0, "indirect commands");
+    mDrawCommandsMemory = Utilities::MemoryRecord(GetName(), "draw commands",
+                                                  mIndices.size() * sizeof(GLuint) +
+                                                  mIndirectCmd.size() * sizeof(DrawElementsIndirectCommand));
 }
 
 void MTField::dispatchSubsetCommands(void(MTField::*fn)(size_t, size_t), size_t nbElements,
@@ -216,11 +253,10 @@ void MTField::initializeGPUData()
 
     // Grid data GPU buffer
     // TODO: Move out of MTField. Should be in a standalone class.
-    GridData gridData;
-    gridData.SliceIndices = glm::ivec4(mState->VoxelGrid.SliceIndices.Get(), 0);
-    gridData.VolumeShape = glm::ivec4(mState->VoxelGrid.VolumeShape.Get(), 0);
-    gridData.IsVisible = glm::ivec4(1, 1, 1, 0);
-    gridData.CurrentSlice = 0;
+    mGridData.SliceIndices = glm::ivec4(mState->VoxelGrid.SliceIndices.Get(), 0);
+    mGridData.VolumeShape = glm::ivec4(mState->VoxelGrid.VolumeShape.Get(), 0);
+    mGridData.IsVisible = glm::ivec4(1, 1, 1, 0);
+    mGridData.CurrentSlice = 0;
 
     const auto& tensorImages = mState->TImages.Get();
 
@@ -302,7 +338,6 @@ void MTField::initializeGPUData()
     mSphereVerticesData = GPU::ShaderData(mSphere->GetPoints().data(), GPU::Binding::sphereVertices, sizeof(glm::vec4) * mSphere->GetPoints().size());
     mSphereIndicesData = GPU::ShaderData(mSphere->GetIndices().data(), GPU::Binding::sphereIndices, sizeof(unsigned int) * mSphere->GetIndices().size());
     mSphereInfoData = GPU::ShaderData(&sphereData, GPU::Binding::sphereInfo, sizeof(SphereData));
-    mGridInfoData = GPU::ShaderData(&gridData, GPU::Binding::gridInfo, sizeof(GridData));
 
     // push all data to GPU
     mTensorValuesData.ToGPU();
@@ -316,16 +351,6 @@ void MTField::initializeGPUData()
     mSphereIndicesData.ToGPU();
     mSphereInfoData.ToGPU();
     mAllSpheresNormalsData.ToGPU();
-    mGridInfoData.ToGPU();
-}
-
-template <typename T>
-GLuint MTField::genVBO(const std::vector<T>& data) const
-{
-    GLuint vbo;
-    glCreateBuffers(1, &vbo);
-    glNamedBufferData(vbo, data.size() * sizeof(T), &data[0], GL_STATIC_DRAW);
-    return vbo;
 }
 
 void MTField::setSliceIndex(glm::vec3 prevIndices, glm::vec3 newIndices)
@@ -337,7 +362,7 @@ void MTField::setSliceIndex(glm::vec3 prevIndices, glm::vec3 newIndices)
     if(mIsSliceDirty.x || mIsSliceDirty.y || mIsSliceDirty.z)
     {
         glm::ivec4 sliceIndices = glm::ivec4(newIndices, 0);
-        mGridInfoData.Update(sizeof(glm::ivec4), sizeof(glm::ivec4), &sliceIndices);
+        mGridData.SliceIndices = sliceIndices;
         scaleSpheres();
     }
 }
@@ -346,7 +371,8 @@ void MTField::setColorMapMode(int previous, int mode)
 {
     if(previous != mode)
     {
-        mSphereInfoData.Update(6*sizeof(unsigned int) + 2*sizeof(float), sizeof(unsigned int), &mode);       
+        mSphereInfoData.Update(6*sizeof(unsigned int) + 2*sizeof(float), sizeof(unsigned int), &mode);
+        updateProgramPipeline();
     }
 }
 
@@ -354,7 +380,8 @@ void MTField::setColorMap(int previous, int mode)
 {
     if(previous != mode)
     {
-        mSphereInfoData.Update(7*sizeof(unsigned int) + 2*sizeof(float), sizeof(unsigned int), &mode);       
+        mSphereInfoData.Update(7*sizeof(unsigned int) + 2*sizeof(float), sizeof(unsigned int), &mode);
+        updateProgramPipeline();
     }
 }
 
@@ -376,6 +403,7 @@ void MTField::setFadeIfHidden(bool previous, bool fadeEnabled)
         mSphereInfoData.Update(5*sizeof(unsigned int) + 2*sizeof(float),
                                sizeof(unsigned int),
                                &uintFadeEnabled);
+        updateProgramPipeline();
     }
 }
 
@@ -400,21 +428,23 @@ void MTField::setVisibleSlices(State::CameraMode previous, State::CameraMode nex
                 isVisible = glm::ivec4(1, 1, 1, 0);
                 break;
         }
-        mGridInfoData.Update(2*sizeof(glm::ivec4), sizeof(glm::ivec4), &isVisible);
+        mGridData.IsVisible = isVisible;
     }
 }
 
 void MTField::drawSpecific()
 {
+    uploadGridData();
     glBindVertexArray(mVAO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndicesBO);
-    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mIndirectBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndicesBO.GetID());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mIndirectBO.GetID());
     glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
                                 (GLvoid*)0, mIndirectCmd.size(), 0);
 }
 
 void MTField::scaleSpheres()
 {
+    Utilities::ProfilerZone zone("MT deformation");
     glUseProgram(mComputeShader.ID());
     if(mIsSliceDirty.x)
     {
@@ -437,7 +467,13 @@ void MTField::scaleSpheres()
 
 void MTField::scaleSpheres(unsigned int sliceId, unsigned int nbSpheres)
 {
-    mGridInfoData.Update(3*sizeof(glm::ivec4), sizeof(unsigned int), &sliceId);
+    mGridData.CurrentSlice = sliceId;
+    uploadGridData();
     glDispatchCompute(nbSpheres, 1, 1);
 }
+
+void MTField::uploadGridData()
+{
+    GPU::StreamRing::Instance().Bind(GPU::Binding::gridInfo, &mGridData, sizeof(GridData));
+}
 } // namespace Slicer
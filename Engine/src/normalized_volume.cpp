@@ -0,0 +1,200 @@
+#include <normalized_volume.h>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace
+{
+/// The histogram is indexed by the 16 most significant bits of the
+/// sortable float key: sign, exponent and 7 bits of mantissa, for a
+/// relative precision of 1/128 over the whole float range.
+const size_t NB_HISTOGRAM_BINS = 1 << 16;
+const unsigned int HISTOGRAM_SHIFT = 16;
+
+/// Map a float to an unsigned key preserving the float ordering.
+inline uint32_t toSortableKey(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(float));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+/// Inverse of toSortableKey.
+inline float fromSortableKey(uint32_t key)
+{
+    const uint32_t bits = (key & 0x80000000u) ? (key & 0x7fffffffu) : ~key;
+    float value;
+    std::memcpy(&value, &bits, sizeof(float));
+    return value;
+}
+}
+
+namespace Slicer
+{
+NormalizedVolume::NormalizedVolume(const NiftiImageWrapper<float>& image,
+                                   float lowPercentile, float highPercentile,
+                                   Utilities::ThreadPool& pool)
+:mDims(image.GetDims())
+,mNbChannels(image.GetDims().w == 1 ? 1 : 3)
+,mSourceStride(image.GetDims().w)
+,mFormat(Format::r16)
+,mTexelSize(0)
+,mWindow(0.0f, 1.0f)
+,mTexels()
+,mTexelsMemory()
+{
+    const DataType datatype = image.GetDataType();
+    if(mNbChannels == 3)
+    {
+        mFormat = Format::rgb10a2;
+        mTexelSize = sizeof(uint32_t);
+    }
+    else if(datatype == DataType::uint8 || datatype == DataType::int8)
+    {
+        // 16 bits would not add any precision to an 8-bit image.
+        mFormat = Format::r8;
+        mTexelSize = sizeof(uint8_t);
+    }
+    else
+    {
+        mFormat = Format::r16;
+        mTexelSize = sizeof(uint16_t);
+    }
+
+    const auto& data = image.GetVoxelData();
+    computeWindow(data, lowPercentile, highPercentile, pool);
+    convert(data, pool);
+}
+
+void NormalizedVolume::computeWindow(const std::vector<float>& data,
+                                     float lowPercentile, float highPercentile,
+                                     Utilities::ThreadPool& pool)
+{
+    const size_t nbVoxels = static_cast<size_t>(mDims.x) * mDims.y * mDims.z;
+    const unsigned int nbThreads = pool.GetNbThreads();
+    std::vector<std::vector<uint64_t>> histograms(nbThreads);
+    std::vector<float> minimums(nbThreads, std::numeric_limits<float>::max());
+    std::vector<float> maximums(nbThreads, std::numeric_limits<float>::lowest());
+
+    // Extrema and histogram in a single pass over the data.
+    pool.ParallelFor(nbVoxels,
+        [&](unsigned int t, size_t begin, size_t end)
+        {
+            std::vector<uint64_t> histogram(NB_HISTOGRAM_BINS, 0);
+            float minimum = minimums[t];
+            float maximum = maximums[t];
+            for(size_t v = begin; v < end; ++v)
+            {
+                for(int c = 0; c < mNbChannels; ++c)
+                {
+                    const float value = data[v * mSourceStride + c];
+                    if(!std::isfinite(value))
+                    {
+                        continue;
+                    }
+                    minimum = std::min(minimum, value);
+                    maximum = std::max(maximum, value);
+                    ++histogram[toSortableKey(value) >> HISTOGRAM_SHIFT];
+                }
+            }
+            histograms[t].swap(histogram);
+            minimums[t] = minimum;
+            maximums[t] = maximum;
+        });
+
+    std::vector<uint64_t> histogram(NB_HISTOGRAM_BINS, 0);
+    uint64_t nbValues = 0;
+    for(unsigned int t = 0; t < nbThreads; ++t)
+    {
+        for(size_t b = 0; b < NB_HISTOGRAM_BINS; ++b)
+        {
+            histogram[b] += histograms[t][b];
+            nbValues += histograms[t][b];
+        }
+    }
+    if(nbValues == 0)
+    {
+        return;
+    }
+
+    const float minimum = *std::min_element(minimums.begin(), minimums.end());
+    const float maximum = *std::max_element(maximums.begin(), maximums.end());
+    const uint64_t lowRank = static_cast<uint64_t>(lowPercentile / 100.0 * nbValues);
+    const uint64_t highRank = static_cast<uint64_t>(highPercentile / 100.0 * nbValues);
+
+    float low = minimum;
+    float high = maximum;
+    bool isLowFound = false;
+    uint64_t cumulative = 0;
+    for(size_t b = 0; b < NB_HISTOGRAM_BINS; ++b)
+    {
+        cumulative += histogram[b];
+        if(!isLowFound && cumulative > lowRank)
+        {
+            // Lower edge of the bin.
+            low = fromSortableKey(static_cast<uint32_t>(b << HISTOGRAM_SHIFT));
+            isLowFound = true;
+        }
+        if(cumulative >= highRank && histogram[b] > 0)
+        {
+            // Upper edge of the bin.
+            const uint32_t lastKey = static_cast<uint32_t>((b << HISTOGRAM_SHIFT) | 0xFFFFu);
+            high = fromSortableKey(lastKey);
+            break;
+        }
+    }
+    low = glm::clamp(low, minimum, maximum);
+    high = glm::clamp(high, minimum, maximum);
+    if(high <= low)
+    {
+        low = minimum;
+        high = maximum > minimum ? maximum : minimum + 1.0f;
+    }
+    mWindow = glm::vec2(low, high);
+}
+
+void NormalizedVolume::convert(const std::vector<float>& data, Utilities::ThreadPool& pool)
+{
+    const size_t nbVoxels = static_cast<size_t>(mDims.x) * mDims.y * mDims.z;
+    mTexels.resize(nbVoxels * mTexelSize);
+    mTexelsMemory = Utilities::MemoryRecord(Utilities::MemoryRegistry::Instance().GetCurrentOwner(),
+                                            "normalized texels", mTexels.size());
+
+    const float low = mWindow.x;
+    const float scale = 1.0f / (mWindow.y - mWindow.x);
+    const auto normalize = [low, scale](float value)
+    {
+        const float normalized = (value - low) * scale;
+        return std::isfinite(normalized) ? glm::clamp(normalized, 0.0f, 1.0f) : 0.0f;
+    };
+
+    pool.ParallelFor(nbVoxels,
+        [&](unsigned int, size_t begin, size_t end)
+        {
+            for(size_t v = begin; v < end; ++v)
+            {
+                const float* src = &data[v * mSourceStride];
+                unsigned char* dst = &mTexels[v * mTexelSize];
+                if(mFormat == Format::r8)
+                {
+                    *dst = static_cast<uint8_t>(std::lround(normalize(src[0]) * 255.0f));
+                }
+                else if(mFormat == Format::r16)
+                {
+                    const uint16_t texel = static_cast<uint16_t>(std::lround(normalize(src[0]) * 65535.0f));
+                    std::memcpy(dst, &texel, sizeof(uint16_t));
+                }
+                else
+                {
+                    // Matches GL_UNSIGNED_INT_2_10_10_10_REV with GL_RGBA.
+                    const uint32_t r = static_cast<uint32_t>(std::lround(normalize(src[0]) * 1023.0f));
+                    const uint32_t g = static_cast<uint32_t>(std::lround(normalize(src[1]) * 1023.0f));
+                    const uint32_t b = static_cast<uint32_t>(std::lround(normalize(src[2]) * 1023.0f));
+                    const uint32_t texel = r | (g << 10) | (b << 20) | (3u << 30);
+                    std::memcpy(dst, &texel, sizeof(uint32_t));
+                }
+            }
+        });
+}
+} // namespace Slicer
@@ -0,0 +1,197 @@
+#include <profiler.h>
+#include <numeric>
+
+namespace Slicer
+{
+namespace Utilities
+{
+namespace
+{
+// Frames in flight before the GPU results of a frame are read back.
+const size_t NB_FRAMES_IN_FLIGHT = 3;
+// Number of frames kept in the history of each zone.
+const size_t HISTORY_SIZE = 120;
+const double NANOSECONDS_PER_MILLISECOND = 1.0e6;
+}
+
+Profiler& Profiler::Instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler()
+:mIsEnabled(false)
+,mIsEnableRequested(false)
+,mFrames(NB_FRAMES_IN_FLIGHT)
+,mCurrentFrame(0)
+,mOpenZones()
+,mZoneStats()
+,mZoneStatsIndices()
+{
+}
+
+void Profiler::SetEnabled(bool enabled)
+{
+    mIsEnableRequested = enabled;
+}
+
+void Profiler::BeginZone(const std::string& name)
+{
+    FrameRecord& frame = mFrames[mCurrentFrame];
+    ZoneRecord zone;
+    zone.StatsIndex = getStatsIndex(name, static_cast<int>(mOpenZones.size()));
+    zone.CPUStart = std::chrono::steady_clock::now();
+    zone.CPUTime = 0.0f;
+    zone.BeginQuery = issueTimestamp();
+    zone.EndQuery = zone.BeginQuery;
+    mOpenZones.push_back(frame.Zones.size());
+    frame.Zones.push_back(zone);
+}
+
+void Profiler::EndZone()
+{
+    FrameRecord& frame = mFrames[mCurrentFrame];
+    ZoneRecord& zone = frame.Zones[mOpenZones.back()];
+    mOpenZones.pop_back();
+    zone.EndQuery = issueTimestamp();
+    zone.CPUTime = std::chrono::duration<float, std::milli>(
+        std::chrono::steady_clock::now() - zone.CPUStart).count();
+}
+
+void Profiler::EndFrame()
+{
+    if(!mOpenZones.empty())
+    {
+        return;
+    }
+
+    // Profiling is only toggled between frames.
+    if(mIsEnableRequested != mIsEnabled)
+    {
+        mIsEnabled = mIsEnableRequested;
+        // Frames recorded before profiling was disabled are discarded.
+        for(FrameRecord& frame : mFrames)
+        {
+            frame.Zones.clear();
+            frame.NbUsedQueries = 0;
+        }
+        return;
+    }
+    if(!mIsEnabled)
+    {
+        return;
+    }
+    mCurrentFrame = (mCurrentFrame + 1) % mFrames.size();
+
+    // The oldest frame is reused, its results are collected first.
+    FrameRecord& frame = mFrames[mCurrentFrame];
+    collectFrame(frame);
+    frame.Zones.clear();
+    frame.NbUsedQueries = 0;
+}
+
+size_t Profiler::issueTimestamp()
+{
+    FrameRecord& frame = mFrames[mCurrentFrame];
+    if(frame.NbUsedQueries == frame.Queries.size())
+    {
+        GLuint query;
+        glGenQueries(1, &query);
+        frame.Queries.push_back(query);
+    }
+    glQueryCounter(frame.Queries[frame.NbUsedQueries], GL_TIMESTAMP);
+    return frame.NbUsedQueries++;
+}
+
+void Profiler::collectFrame(FrameRecord& frame)
+{
+    if(frame.Zones.empty())
+    {
+        return;
+    }
+
+    // Queries complete in order, the last one tells if all are available.
+    GLint isAvailable = GL_FALSE;
+    glGetQueryObjectiv(frame.Queries[frame.NbUsedQueries - 1],
+                       GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+
+    // Zones with the same name are summed over the frame.
+    std::vector<float> cpuTimes(mZoneStats.size(), 0.0f);
+    std::vector<float> gpuTimes(mZoneStats.size(), 0.0f);
+    std::vector<bool> isMeasured(mZoneStats.size(), false);
+    for(const ZoneRecord& zone : frame.Zones)
+    {
+        cpuTimes[zone.StatsIndex] += zone.CPUTime;
+        isMeasured[zone.StatsIndex] = true;
+        if(isAvailable == GL_TRUE)
+        {
+            GLuint64 begin, end;
+            glGetQueryObjectui64v(frame.Queries[zone.BeginQuery], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.Queries[zone.EndQuery], GL_QUERY_RESULT, &end);
+            gpuTimes[zone.StatsIndex] += static_cast<float>((end - begin) / NANOSECONDS_PER_MILLISECOND);
+        }
+    }
+
+    for(size_t i = 0; i < mZoneStats.size(); ++i)
+    {
+        if(!isMeasured[i])
+        {
+            continue;
+        }
+        ZoneStats& stats = mZoneStats[i];
+        pushHistory(cpuTimes[i], stats.CPUHistory, stats.CPUAverage);
+        if(isAvailable == GL_TRUE)
+        {
+            pushHistory(gpuTimes[i], stats.GPUHistory, stats.GPUAverage);
+        }
+    }
+}
+
+size_t Profiler::getStatsIndex(const std::string& name, int depth)
+{
+    const auto key = std::make_pair(name, depth);
+    auto it = mZoneStatsIndices.find(key);
+    if(it != mZoneStatsIndices.end())
+    {
+        return it->second;
+    }
+    ZoneStats stats;
+    stats.Name = name;
+    stats.Depth = depth;
+    stats.CPUAverage = 0.0f;
+    stats.GPUAverage = 0.0f;
+    mZoneStats.push_back(stats);
+    mZoneStatsIndices[key] = mZoneStats.size() - 1;
+    return mZoneStats.size() - 1;
+}
+
+void Profiler::pushHistory(float time, std::vector<float>& history, float& average)
+{
+    if(history.size() == HISTORY_SIZE)
+    {
+        history.erase(history.begin());
+    }
+    history.push_back(time);
+    average = std::accumulate(history.begin(), history.end(), 0.0f)
+            / static_cast<float>(history.size());
+}
+
+ProfilerZone::ProfilerZone(const std::string& name)
+:mIsOpen(Profiler::Instance().IsEnabled())
+{
+    if(mIsOpen)
+    {
+        Profiler::Instance().BeginZone(name);
+    }
+}
+
+ProfilerZone::~ProfilerZone()
+{
+    if(mIsOpen)
+    {
+        Profiler::Instance().EndZone();
+    }
+}
+} // namespace Utilities
+} // namespace Slicer
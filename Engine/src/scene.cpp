@@ -5,6 +5,8 @@
 #include <glm/gtx/transform.hpp>
 #include <utils.hpp>
 #include <application_state.h>
+#include <profiler.h>
+#include <memory_registry.h>
 
 namespace Slicer
 {
@@ -19,27 +21,44 @@ Scene::~Scene()
 void Scene::AddSHField()
 {
     // create a SH Field model
+    Utilities::MemoryOwner owner("SH field");
     mModels.push_back(std::shared_ptr<SHField>(new SHField(mState, mCoordinateSystem)));
 }
 
 void Scene::AddMTField()
 {
     // create a Multi-Tensor Field model
+    Utilities::MemoryOwner owner("MT field");
     mModels.push_back(std::shared_ptr<MTField>(new MTField(mState, mCoordinateSystem)));
 }
 
 void Scene::AddTexture()
 {
     // create a Texture model
+    Utilities::MemoryOwner owner("Background");
     mModels.push_back(std::shared_ptr<Texture>(new Texture(mState, mCoordinateSystem)));
 }
 
-void Scene::Render()
+void Scene::Render(const Camera& camera)
 {
+    const glm::mat4 viewProjection = camera.GetViewProjection();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     for(auto model : mModels)
     {
-        model->Draw();
+        Utilities::ProfilerZone zone(model->GetName());
+        model->Draw(viewProjection);
     }
 }
+
+bool Scene::HasPendingUpdates() const
+{
+    for(const auto& model : mModels)
+    {
+        if(model->HasPendingUpdates())
+        {
+            return true;
+        }
+    }
+    return false;
+}
 } // namespace Slicer
@@ -1,10 +1,59 @@
 #include <sh_field.h>
+#include <profiler.h>
+#include <memory_registry.h>
+#include <stream_ring.h>
 #include <glad/glad.h>
 #include <timer.h>
+#include <utils.hpp>
+#include <algorithm>
+#include <iostream>
+#include <limits>
 
 namespace
 {
 const int NB_THREADS_FOR_SPHERES = 2;
+const unsigned int NB_PLANES = 3;
+
+// Maximum SH order evaluated when a slice changes. Higher bands are
+// added once the slice stops changing.
+const float PREVIEW_SH_ORDER = 2.0f;
+
+// Planes are deformed by square tiles of voxels. Must match TILE_SIZE
+// in orthogrid_util.glsl.
+const unsigned int TILE_SIZE = 16;
+
+// Radius on screen, in pixels, up to which glyphs are drawn with the
+// coarsest level of detail. Each finer level doubles the radius.
+const float LEVEL_ZERO_RADIUS = 4.0f;
+
+// Radius on screen, in pixels, under which glyphs are aggregated into
+// a quad colored by their peak direction. Glyphs fade back in up to
+// twice the radius.
+const float AGGREGATE_RADIUS = 2.0f;
+
+// Indices of the quad drawn for aggregated glyphs, appended to the
+// levels of detail in the element buffer.
+const std::array<GLuint, 6> QUAD_INDICES = {0, 1, 2, 0, 2, 3};
+
+// Edge of the bricks of SH coefficients, in voxels.
+const int BRICK_SIZE = Slicer::NiftiImageWrapper<float>::BRICK_SIZE;
+
+// Size of the budget unit of the SH coefficients cache.
+const size_t BYTES_PER_MEBIBYTE = 1024 * 1024;
+
+// Work group size of the level of detail pass.
+const unsigned int LEVEL_OF_DETAIL_GROUP_SIZE = 64;
+
+// Bytes of a new sphere resolution uploaded per draw, the previous
+// resolution is drawn until the upload is complete.
+const size_t SPHERE_UPLOAD_CHUNK_SIZE = 8 * 1024 * 1024;
+
+template <typename T>
+bool isReady(const std::future<T>& future)
+{
+    return future.valid()
+        && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
 }
 
 namespace Slicer
@@ -12,33 +61,98 @@ namespace Slicer
 SHField::SHField(const std::shared_ptr<ApplicationState>& state,
                  std::shared_ptr<CoordinateSystem> parent)
 :Model(state)
-,mIndices()
 ,mNbSpheresX(0)
 ,mNbSpheresY(0)
 ,mNbSpheresZ(0)
-,mIsSliceDirty(true)
+,mRequestedSlices(state->VoxelGrid.SliceIndices.Get())
+,mFrontBuffers()
+,mBufferSlices()
+,mTileNbCoeffs()
+,mNbTiles()
+,mSeenTiles()
+,mSeenTilesSlices()
+,mHasStaleTiles()
+,mNbPreviewCoeffs(0)
+,mDeformationFences()
 ,mVAO(0)
-,mIndicesBO(0)
-,mIndirectBO(0)
+,mIndicesBO()
+,mIndirectBO()
+,mLevelsData()
+,mLowRankVolume()
 ,mSphHarmCoeffsData()
+,mBrickCache()
 ,mSphHarmFuncsData()
 ,mSphereVerticesData()
 ,mSphereIndicesData()
 ,mSphereInfoData()
+,mAllRadiisData()
+,mAllMaxAmplitudeData()
 ,mAllSpheresNormalsData()
 ,mIndirectCmd()
 ,mSphere(nullptr)
+,mResolution(0)
+,mRequestedResolution(state->Sphere.Resolution.Get())
+,mSphereBuilder(new Utilities::ThreadPool(1))
+,mSphereBuild()
+,mPendingSphere()
+,mDrawCommandsMemory()
 {
+    mDeformationFences.fill(nullptr);
+    mHasStaleTiles.fill(true);
     resetCS(std::shared_ptr<CoordinateSystem>(new CoordinateSystem(glm::mat4(1.0f), parent)));
+    if(state->SHRank.Get() > 0)
+    {
+        // The shaders are specialized for the compressed values.
+        Utilities::AutoTimer timer("SH coefficients compression");
+        mLowRankVolume.reset(new LowRankSHVolume(state->FODFImage.Get(), state->SHRank.Get(),
+                                                 *state->WorkerPool));
+        std::cout << "SH coefficients compressed to " << mLowRankVolume->GetNbValuesPerVoxel() - 1
+                  << " components, relative reconstruction error: "
+                  << mLowRankVolume->GetRelativeError() << std::endl;
+    }
     initializeModel();
     initializeMembers();
     initializeGPUData();
 
-    scaleSpheres();
+    // Spheres are deformed by the first draw, once the tiles in view are known.
 }
 
 SHField::~SHField()
 {
+    for(auto& fence : mDeformationFences)
+    {
+        if(fence != nullptr)
+        {
+            glDeleteSync(fence);
+        }
+    }
+    if(mPendingSphere != nullptr && mPendingSphere->DeformationFence != nullptr)
+    {
+        glDeleteSync(mPendingSphere->DeformationFence);
+    }
+    if(mVAO != 0)
+    {
+        glDeleteVertexArrays(1, &mVAO);
+    }
+}
+
+bool SHField::HasPendingUpdates() const
+{
+    // The sphere of a new resolution is built and uploaded over several frames.
+    if(mRequestedResolution != mResolution || mPendingSphere != nullptr)
+    {
+        return true;
+    }
+
+    // Tiles never seen by a view are left stale until they come in view.
+    for(unsigned int plane = 0; plane < NB_PLANES; ++plane)
+    {
+        if(mDeformationFences[plane] != nullptr || mHasStaleTiles[plane])
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
 void SHField::updateApplicationStateAtInit()
@@ -83,6 +197,12 @@ void SHField::registerStateCallbacks()
             this->setFadeIfHidden(p, n);
         }
     );
+    mState->Sphere.Resolution.RegisterCallback(
+        [this](int p, int n)
+        {
+            this->setSphereResolution(p, n);
+        }
+    );
     mState->ViewMode.Mode.RegisterCallback(
         [this](State::CameraMode p, State::CameraMode n)
         {
@@ -93,171 +213,466 @@ void SHField::registerStateCallbacks()
 
 void SHField::initProgramPipeline()
 {
-    const std::string vsPath = DMRI_EXPLORER_BINARY_DIR + std::string("/shaders/shfield_vert.glsl");
     const std::string fsPath = DMRI_EXPLORER_BINARY_DIR + std::string("/shaders/shfield_frag.glsl");
+    mFragmentShader = GPU::ShaderProgram(fsPath, GL_FRAGMENT_SHADER);
+    updateProgramPipeline();
+}
+
+std::vector<std::string> SHField::getBaseDefines() const
+{
+    std::vector<std::string> defines;
+    if(!mState->GenericShaders.Get())
+    {
+        // The loops over SH coefficients get a constant trip count.
+        defines.push_back("NB_COEFFS " + std::to_string(getNbValuesPerVoxel()) + "u");
+    }
+    if(mState->FODFImage.Get().IsBricked())
+    {
+        // The layout is chosen at load, both variants need it.
+        defines.push_back("SH_LAYOUT_BRICKED");
+    }
+    if(mState->SHCacheSize.Get() > 0)
+    {
+        defines.push_back("SH_BRICK_CACHE");
+    }
+    return defines;
+}
+
+void SHField::updateProgramPipeline()
+{
+    // Key 0 is the generic variant, reading the state at runtime.
+    unsigned int key = 0;
+    std::vector<std::string> defines = getBaseDefines();
+    if(!mState->GenericShaders.Get())
+    {
+        const unsigned int colorMapMode = mState->Sphere.ColorMapMode.Get();
+        const unsigned int isNormalized = mState->Sphere.IsNormalized.Get() ? 1 : 0;
+        const unsigned int fadeIfHidden = mState->Sphere.FadeIfHidden.Get() ? 1 : 0;
+        key = 1 + (colorMapMode | isNormalized << 4 | fadeIfHidden << 5);
+        defines.push_back("COLOR_MAP_MODE " + std::to_string(colorMapMode) + "u");
+        defines.push_back("IS_NORMALIZED " + std::to_string(isNormalized) + "u");
+        defines.push_back("FADE_IF_HIDDEN " + std::to_string(fadeIfHidden) + "u");
+    }
 
-    std::vector<GPU::ShaderProgram> shaders;
-    shaders.push_back(GPU::ShaderProgram(vsPath, GL_VERTEX_SHADER));
-    shaders.push_back(GPU::ShaderProgram(fsPath, GL_FRAGMENT_SHADER));
-    mProgramPipeline = GPU::ProgramPipeline(shaders);
+    auto variant = mPipelineVariants.find(key);
+    if(variant == mPipelineVariants.end())
+    {
+        const std::string vsPath = DMRI_EXPLORER_BINARY_DIR + std::string("/shaders/shfield_vert.glsl");
+        std::vector<GPU::ShaderProgram> shaders;
+        shaders.push_back(GPU::ShaderProgram(vsPath, GL_VERTEX_SHADER, defines));
+        shaders.push_back(mFragmentShader);
+        variant = mPipelineVariants.emplace(key, GPU::ProgramPipeline(shaders)).first;
+    }
+    mProgramPipeline = variant->second;
 }
 
 void SHField::initializeMembers()
 {
     // Initialize compute shader
     const std::string csPath = DMRI_EXPLORER_BINARY_DIR + std::string("/shaders/shfield_comp.glsl");
-    mComputeShader = GPU::ShaderProgram(csPath, GL_COMPUTE_SHADER);
+    mComputeShader = GPU::ShaderProgram(csPath, GL_COMPUTE_SHADER, getBaseDefines());
+    const std::string lodPath = DMRI_EXPLORER_BINARY_DIR + std::string("/shaders/shfield_lod_comp.glsl");
+    mLevelOfDetailShader = GPU::ShaderProgram(lodPath, GL_COMPUTE_SHADER, getBaseDefines());
 
-    // Initialize a sphere for SH to SF projection
     const auto& image = mState->FODFImage.Get();
     const auto& dims = image.GetDims();
     mNbSpheresX = dims.y * dims.z;
     mNbSpheresY = dims.x * dims.z;
     mNbSpheresZ = dims.x * dims.y;
-    mSphere.reset(new Primitive::Sphere(mState->Sphere.Resolution.Get(), dims.w));
 
-    // Preallocate buffers for draw call
-    const auto numIndices = mSphere->GetIndices().size();
-    const int nbSpheres = getMaxNbSpheres();
-    mIndices.resize(nbSpheres * numIndices);
-    mIndirectCmd.resize(nbSpheres);
+    // Tiles of each plane, all buffers start without any deformed tile.
+    for(unsigned int plane = 0; plane < NB_PLANES; ++plane)
+    {
+        const glm::ivec2 axes = getPlaneAxes(plane);
+        mNbTiles[plane] = glm::uvec2((dims[axes.x] + TILE_SIZE - 1) / TILE_SIZE,
+                                     (dims[axes.y] + TILE_SIZE - 1) / TILE_SIZE);
+        for(auto& nbCoeffs : mTileNbCoeffs[plane])
+        {
+            nbCoeffs.assign(mNbTiles[plane].x * mNbTiles[plane].y, 0);
+        }
+        mBufferSlices[plane].fill(-1);
+        mSeenTiles[plane].assign(mNbTiles[plane].x * mNbTiles[plane].y, false);
+        mSeenTilesSlices[plane] = -1;
+    }
+
+    // Initialize a sphere for SH to SF projection, uploaded at once.
+    std::unique_ptr<SphereBuild> build = buildSphere(mRequestedResolution, dims.w, getMaxNbSpheres(),
+                                                     mLowRankVolume);
+    uploadSphereChunk(*build, std::numeric_limits<size_t>::max());
+    applySphereBuild(std::move(build));
+
+    // Coefficients are sorted by order, the preview evaluates the first ones.
+    // Components are sorted by decreasing energy, the same count is used.
+    const std::vector<float> orders = mSphere->GetOrdersList();
+    mNbPreviewCoeffs = static_cast<unsigned int>(
+        std::count_if(orders.begin(), orders.end(),
+                      [](float order) { return order <= PREVIEW_SH_ORDER; }));
+    mNbPreviewCoeffs = std::min(mNbPreviewCoeffs, getNbValuesPerVoxel());
+
+    glCreateVertexArrays(1, &mVAO);
+}
+
+std::unique_ptr<SHField::SphereBuild> SHField::buildSphere(int resolution, unsigned int nbCoeffs,
+                                                           unsigned int nbSpheres,
+                                                           std::shared_ptr<const LowRankSHVolume> lowRankVolume)
+{
+    std::unique_ptr<SphereBuild> build(new SphereBuild());
+    build->Resolution = resolution;
+    build->Sphere.reset(new Primitive::Sphere(resolution, nbCoeffs));
+    build->SHFuncs = build->Sphere->GetSHFuncs();
+    if(lowRankVolume != nullptr)
+    {
+        // The deformation sums one term per component instead of one
+        // per coefficient.
+        build->SHFuncs = lowRankVolume->ProjectSHFunctions(build->SHFuncs);
+    }
+    build->ElementIndices = build->Sphere->GetLevelIndices();
+    build->ElementIndices.insert(build->ElementIndices.end(), QUAD_INDICES.begin(), QUAD_INDICES.end());
+    build->IsAllocated = false;
+    build->NbUploadedSHFuncsBytes = 0;
+    build->NbUploadedCommandsBytes = 0;
+    build->Slices.fill(-1);
+    build->DeformationFence = nullptr;
+
+    // Commands start with the finest level, the last one.
+    const std::vector<size_t> levelFirstIndices = build->Sphere->GetLevelFirstIndices();
+    const size_t finest = levelFirstIndices.size() - 2;
+    const unsigned int nbElements = static_cast<unsigned int>(levelFirstIndices[finest + 1] - levelFirstIndices[finest]);
+    const unsigned int firstElement = static_cast<unsigned int>(levelFirstIndices[finest]);
+    const size_t nbSphereVertices = build->Sphere->GetPoints().size();
+    build->Commands.resize(nbSpheres);
 
-    // Copy sphere indices and instantiate draw commands.
     std::vector<std::thread> threads;
-    dispatchSubsetCommands(&SHField::initializeSubsetDrawCommand,
-                          nbSpheres, NB_THREADS_FOR_SPHERES, threads);
+    const size_t nbSpheresPerThread = nbSpheres / NB_THREADS_FOR_SPHERES;
+    for(int i = 0; i < NB_THREADS_FOR_SPHERES; ++i)
+    {
+        const size_t firstIndex = i * nbSpheresPerThread;
+        const size_t lastIndex = i + 1 < NB_THREADS_FOR_SPHERES ? firstIndex + nbSpheresPerThread : nbSpheres;
+        threads.push_back(std::thread(&SHField::FillDrawCommands, nbElements, firstElement,
+                                      nbSphereVertices, firstIndex, lastIndex,
+                                      std::ref(build->Commands)));
+    }
 
     // wait for all threads to finish
     for(auto& t : threads)
     {
         t.join();
     }
+    return build;
+}
 
-    // Bind primitives to GPU
-    glCreateVertexArrays(1, &mVAO);
-    mIndicesBO = genVBO<GLuint>(mIndices);
-    mIndirectBO = genVBO<DrawElementsIndirectCommand>(mIndirectCmd);
+void SHField::FillDrawCommands(unsigned int nbElements, unsigned int firstElement,
+                               size_t nbSphereVertices,
+                               size_t firstIndex, size_t lastIndex,
+                               std::vector<DrawElementsIndirectCommand>& commands)
+{
+    const auto numVertices = nbSphereVertices;
+
+    for(size_t i = firstIndex; i < lastIndex; ++i)
+    {
+        // Add indirect draw command for current sphere
+        commands[i] =
+            DrawElementsIndirectCommand(
+                nbElements, // num of elements to draw per drawID
+                1, // number of identical instances
+                firstElement, // offset in element buffer
+                static_cast<unsigned int>(i * numVertices), // offset added to the vertex indices
+                static_cast<unsigned int>(i)); // sphere index, read as gl_BaseInstance
+    }
+}
+
+bool SHField::uploadSphereChunk(SphereBuild& build, size_t maxNbBytes) const
+{
+    if(!build.IsAllocated)
+    {
+        const auto& sphere = *build.Sphere;
+        const size_t nbSphereVertices = sphere.GetPoints().size();
+        const size_t nbSpheres = build.Commands.size();
+        const std::vector<glm::vec4> points = sphere.GetPoints();
+        const std::vector<GLuint> indices = sphere.GetIndices();
+        build.IndicesBO = GPU::Buffer(build.ElementIndices.size() * sizeof(GLuint),
+                                      build.ElementIndices.data(), 0, "indices");
+        build.IndirectBO = GPU::Buffer(build.Commands.size() * sizeof(DrawElementsIndirectCommand),
+                                       nullptr, GL_DYNAMIC_STORAGE_BIT, "indirect commands");
+
+        // Element count and offset of each level, read by the level of detail pass.
+        const std::vector<size_t> levelFirstIndices = sphere.GetLevelFirstIndices();
+        std::vector<glm::uvec2> levels;
+        for(size_t level = 0; level + 1 < levelFirstIndices.size(); ++level)
+        {
+            levels.push_back(glm::uvec2(levelFirstIndices[level + 1] - levelFirstIndices[level],
+                                        levelFirstIndices[level]));
+        }
+        build.LevelsData = GPU::ShaderData(levels.data(), GPU::Binding::lodLevels, sizeof(glm::uvec2) * levels.size());
+        build.SphHarmFuncsData = GPU::ShaderData(GPU::Binding::shFunctions, sizeof(float) * build.SHFuncs.size());
+        build.SphereVerticesData = GPU::ShaderData(points.data(), GPU::Binding::sphereVertices, sizeof(glm::vec4) * points.size());
+        build.SphereIndicesData = GPU::ShaderData(indices.data(), GPU::Binding::sphereIndices, sizeof(unsigned int) * indices.size());
+
+        // Glyphs are only drawn once deformed, the storage is not initialized.
+        for(unsigned int buffer = 0; buffer < build.AllRadiisData.size(); ++buffer)
+        {
+            build.AllSpheresNormalsData[buffer] = GPU::ShaderData(GPU::Binding::allSpheresNormals, sizeof(glm::vec4) * nbSpheres * nbSphereVertices);
+            build.AllRadiisData[buffer] = GPU::ShaderData(GPU::Binding::allRadiis, sizeof(float) * nbSpheres * nbSphereVertices);
+            build.AllMaxAmplitudeData[buffer] = GPU::ShaderData(GPU::Binding::allMaxAmplitude, sizeof(glm::vec4) * nbSpheres);
+        }
+        build.IsAllocated = true;
+    }
+
+    const size_t shFuncsSize = sizeof(float) * build.SHFuncs.size();
+    const size_t nbSHFuncsBytes = std::min(maxNbBytes, shFuncsSize - build.NbUploadedSHFuncsBytes);
+    if(nbSHFuncsBytes > 0)
+    {
+        build.SphHarmFuncsData.Update(build.NbUploadedSHFuncsBytes, nbSHFuncsBytes,
+                                      reinterpret_cast<const char*>(build.SHFuncs.data()) + build.NbUploadedSHFuncsBytes);
+        build.NbUploadedSHFuncsBytes += nbSHFuncsBytes;
+        maxNbBytes -= nbSHFuncsBytes;
+    }
+
+    const size_t commandsSize = sizeof(DrawElementsIndirectCommand) * build.Commands.size();
+    const size_t nbCommandsBytes = std::min(maxNbBytes, commandsSize - build.NbUploadedCommandsBytes);
+    if(nbCommandsBytes > 0)
+    {
+        glNamedBufferSubData(build.IndirectBO.GetID(), build.NbUploadedCommandsBytes, nbCommandsBytes,
+                             reinterpret_cast<const char*>(build.Commands.data()) + build.NbUploadedCommandsBytes);
+        build.NbUploadedCommandsBytes += nbCommandsBytes;
+    }
+
+    return build.NbUploadedSHFuncsBytes == shFuncsSize
+        && build.NbUploadedCommandsBytes == commandsSize;
 }
 
-void SHField::dispatchSubsetCommands(void(SHField::*fn)(size_t, size_t), size_t nbElements,
-                                     size_t nbThreads, std::vector<std::thread>& threads)
+void SHField::applySphereBuild(std::unique_ptr<SphereBuild> build)
 {
-    size_t nbElementsPerThread = nbElements / nbThreads;
-    size_t startIndex = 0;
-    size_t stopIndex = nbElementsPerThread;
-    for(int i = 0; i < nbThreads - 1; ++i)
+    // The new storage starts without any deformed tile.
+    for(unsigned int plane = 0; plane < NB_PLANES; ++plane)
     {
-        threads.push_back(std::thread(fn, this, startIndex, stopIndex));
-        startIndex = stopIndex;
-        stopIndex += nbElementsPerThread;
+        GLsync& fence = mDeformationFences[plane];
+        if(fence != nullptr)
+        {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+        mFrontBuffers[plane] = 0;
+        mBufferSlices[plane] = {build->Slices[plane], -1};
+        for(auto& nbCoeffs : mTileNbCoeffs[plane])
+        {
+            std::fill(nbCoeffs.begin(), nbCoeffs.end(), 0);
+        }
+        if(!build->TileNbCoeffs[plane].empty())
+        {
+            mTileNbCoeffs[plane][0] = build->TileNbCoeffs[plane];
+        }
+        mHasStaleTiles[plane] = true;
     }
-    threads.push_back(std::thread(fn, this, startIndex, nbElements));
+
+    mResolution = build->Resolution;
+    mSphere = build->Sphere;
+    mIndicesBO = std::move(build->IndicesBO);
+    mIndirectBO = std::move(build->IndirectBO);
+    mLevelsData = std::move(build->LevelsData);
+    mSphHarmFuncsData = std::move(build->SphHarmFuncsData);
+    mSphereVerticesData = std::move(build->SphereVerticesData);
+    mSphereIndicesData = std::move(build->SphereIndicesData);
+    mAllRadiisData = std::move(build->AllRadiisData);
+    mAllMaxAmplitudeData = std::move(build->AllMaxAmplitudeData);
+    mAllSpheresNormalsData = std::move(build->AllSpheresNormalsData);
+    mIndirectCmd = std::move(build->Commands);
+    mDrawCommandsMemory = Utilities::MemoryRecord(GetName(), "draw commands",
+                                                  mIndirectCmd.size() * sizeof(DrawElementsIndirectCommand));
+
+    mSphHarmFuncsData.ToGPU();
+    mSphereVerticesData.ToGPU();
+    mSphereIndicesData.ToGPU();
 }
 
-void SHField::initializeSubsetDrawCommand(size_t firstIndex, size_t lastIndex)
+void SHField::updateSphereResolution()
 {
-    const auto& indices = mSphere->GetIndices();
-    const auto numIndices = indices.size();
-    const auto numVertices = mSphere->GetPoints().size();
+    if(isReady(mSphereBuild))
+    {
+        mPendingSphere = mSphereBuild.get();
+    }
 
-    size_t i, j;
-    for(i = firstIndex; i < lastIndex; ++i)
+    // Only the latest requested resolution is uploaded.
+    if(mPendingSphere != nullptr && mPendingSphere->Resolution != mRequestedResolution)
     {
-        // Add sphere faces
-        for(j = 0; j < numIndices; ++j)
+        if(mPendingSphere->DeformationFence != nullptr)
         {
-            mIndices[i*numIndices+j] = indices[j];
+            glDeleteSync(mPendingSphere->DeformationFence);
         }
+        mPendingSphere.reset();
+    }
+    if(!mSphereBuild.valid() && mPendingSphere == nullptr && mRequestedResolution != mResolution)
+    {
+        const int resolution = mRequestedResolution;
+        const unsigned int nbCoeffs = mState->FODFImage.Get().GetDims().w;
+        const unsigned int nbSpheres = getMaxNbSpheres();
+        const std::shared_ptr<const LowRankSHVolume> lowRankVolume = mLowRankVolume;
+        mSphereBuild = mSphereBuilder->Submit([resolution, nbCoeffs, nbSpheres, lowRankVolume]()
+        {
+            return buildSphere(resolution, nbCoeffs, nbSpheres, lowRankVolume);
+        });
+    }
 
-        // Add indirect draw command for current sphere
-        mIndirectCmd[i] =
-            DrawElementsIndirectCommand(
-                static_cast<unsigned int>(numIndices), // num of elements to draw per drawID
-                1, // number of identical instances
-                0, // offset in VBO
-                static_cast<unsigned int>(i * numVertices), // offset in element buffer array
-                0);
+    if(mPendingSphere == nullptr)
+    {
+        return;
+    }
+    GLsync& fence = mPendingSphere->DeformationFence;
+    if(fence == nullptr)
+    {
+        if(uploadSphereChunk(*mPendingSphere, SPHERE_UPLOAD_CHUNK_SIZE))
+        {
+            deformSphereBuild(*mPendingSphere);
+        }
+    }
+    else if(glClientWaitSync(fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+    {
+        glDeleteSync(fence);
+        fence = nullptr;
+
+        // The deformation is complete, the barrier only makes its
+        // writes visible to the draws and does not stall.
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        applySphereBuild(std::move(mPendingSphere));
+        const unsigned int sizes[2] = {static_cast<unsigned int>(mSphere->GetPoints().size()),
+                                       static_cast<unsigned int>(mSphere->GetIndices().size())};
+        mSphereInfoData.Update(0, 2*sizeof(unsigned int), sizes);
     }
 }
 
-void SHField::initializeGPUData()
+void SHField::deformSphereBuild(SphereBuild& build)
 {
-    const int nbSpheres = getMaxNbSpheres();
+    // The compute pass reads the new sphere, the draws of this frame
+    // read the sphere in use again.
+    const SphereData sphereData = getSphereData(*build.Sphere);
+    GPU::StreamRing::Instance().Bind(GPU::Binding::sphereInfo, &sphereData, sizeof(SphereData));
+    build.SphHarmFuncsData.Bind();
+    build.SphereVerticesData.Bind();
+    build.SphereIndicesData.Bind();
+    build.AllRadiisData[0].Bind();
+    build.AllSpheresNormalsData[0].Bind();
+    build.AllMaxAmplitudeData[0].Bind();
+
+    glUseProgram(mComputeShader.ID());
+    for(unsigned int plane = 0; plane < NB_PLANES; ++plane)
+    {
+        const unsigned int front = mFrontBuffers[plane];
+        build.Slices[plane] = mBufferSlices[plane][front];
+        build.TileNbCoeffs[plane] = mTileNbCoeffs[plane][front];
+        if(build.Slices[plane] < 0)
+        {
+            continue;
+        }
+
+        // Tiles are deformed with as many bands as in the front buffer.
+        std::map<GLuint, std::vector<GLuint>> passes;
+        const auto& tileNbCoeffs = build.TileNbCoeffs[plane];
+        for(GLuint tile = 0; tile < tileNbCoeffs.size(); ++tile)
+        {
+            if(tileNbCoeffs[tile] > 0)
+            {
+                passes[tileNbCoeffs[tile]].push_back(tile);
+            }
+        }
+        if(passes.empty())
+        {
+            continue;
+        }
+
+        GridData gridData = mGridData;
+        gridData.SliceIndices[plane] = build.Slices[plane];
+        gridData.CurrentSlice = plane;
+        uploadGridData(gridData);
+        for(const auto& pass : passes)
+        {
+            scaleTiles(0, pass.first, pass.second);
+        }
+    }
+    glUseProgram(0);
+    build.DeformationFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
-    // temporary zero-filled array for all spheres vertices and normals
-    std::vector<glm::vec4> allVertices(nbSpheres * mSphere->GetPoints().size());
-    std::vector<float> allRadiis(nbSpheres * mSphere->GetPoints().size());
+    mSphereInfoData.Bind();
+    mSphHarmFuncsData.Bind();
+    mSphereVerticesData.Bind();
+    mSphereIndicesData.Bind();
+}
+
+void SHField::initializeGPUData()
+{
     std::vector<float> allOrders = mSphere->GetOrdersList();
-    std::vector<float> allMaxAmplitude(nbSpheres);
 
     // Sphere data GPU buffer
-    SphereData sphereData;
-    sphereData.NumVertices = static_cast<unsigned int>(mSphere->GetPoints().size());
-    sphereData.NumIndices = static_cast<unsigned int>(mSphere->GetIndices().size());
-    sphereData.IsNormalized = mState->Sphere.IsNormalized.Get();
-    sphereData.MaxOrder = mSphere->GetMaxSHOrder();
-    sphereData.SH0threshold = mState->Sphere.SH0Threshold.Get();
-    sphereData.Scaling = mState->Sphere.Scaling.Get();
-    sphereData.NbCoeffs = mState->FODFImage.Get().GetDims().w;
-    sphereData.FadeIfHidden = mState->Sphere.FadeIfHidden.Get();
-    sphereData.ColorMapMode = mState->Sphere.ColorMapMode.Get();
+    const SphereData sphereData = getSphereData(*mSphere);
 
     // Grid data GPU buffer
     // TODO: Move out of SHField. Should be in a standalone class.
-    GridData gridData;
-    gridData.SliceIndices = glm::ivec4(mState->VoxelGrid.SliceIndices.Get(), 0);
-    gridData.VolumeShape = glm::ivec4(mState->VoxelGrid.VolumeShape.Get(), 0);
-    gridData.IsVisible = glm::ivec4(1, 1, 1, 0);
-    gridData.CurrentSlice = 0;
+    mGridData.SliceIndices = glm::ivec4(mState->VoxelGrid.SliceIndices.Get(), 0);
+    mGridData.VolumeShape = glm::ivec4(mState->VoxelGrid.VolumeShape.Get(), 0);
+    mGridData.IsVisible = glm::ivec4(1, 1, 1, 0);
+    mGridData.CurrentSlice = 0;
 
-    // The SH coefficients image to copy on the GPU.
-    const auto& image = mState->FODFImage.Get();
+    // The SH coefficients to copy on the GPU.
+    const std::vector<float>& coeffs = getSHCoeffs();
 
-    mAllSpheresNormalsData = GPU::ShaderData(allVertices.data(), GPU::Binding::allSpheresNormals, sizeof(glm::vec4) * allVertices.size());
-    mAllRadiisData = GPU::ShaderData(allRadiis.data(), GPU::Binding::allRadiis, sizeof(float) * allRadiis.size());
-    mSphHarmCoeffsData = GPU::ShaderData(image.GetVoxelData().data(), GPU::Binding::shCoeffs, sizeof(float) * image.GetVoxelData().size());
-    mSphHarmFuncsData = GPU::ShaderData(mSphere->GetSHFuncs().data(), GPU::Binding::shFunctions, sizeof(float) * mSphere->GetSHFuncs().size());
+    // The storage sized for the sphere is created with the sphere.
+    if(mState->SHCacheSize.Get() > 0)
+    {
+        // The pool holds at least the bricks of three slices per plane,
+        // and at most the whole image.
+        const glm::ivec3 nbBricks = getNbBricks();
+        const size_t nbValuesPerBrick = static_cast<size_t>(BRICK_SIZE) * BRICK_SIZE * BRICK_SIZE
+                                      * getNbValuesPerVoxel();
+        const size_t budget = static_cast<size_t>(mState->SHCacheSize.Get()) * BYTES_PER_MEBIBYTE;
+        const size_t nbBricksInUse = 3 * static_cast<size_t>(nbBricks.y * nbBricks.z +
+                                                             nbBricks.x * nbBricks.z +
+                                                             nbBricks.x * nbBricks.y);
+        const size_t nbSlots = std::min(std::max(budget / (sizeof(float) * nbValuesPerBrick), nbBricksInUse),
+                                        static_cast<size_t>(nbBricks.x) * nbBricks.y * nbBricks.z);
+        mBrickCache.reset(new GPU::BrickCache(coeffs.data(), nbValuesPerBrick,
+                                              nbBricks.x * nbBricks.y * nbBricks.z,
+                                              static_cast<GLuint>(nbSlots),
+                                              GPU::Binding::shCoeffs, GPU::Binding::brickPageTable));
+    }
+    else
+    {
+        mSphHarmCoeffsData = GPU::ShaderData(coeffs.data(), GPU::Binding::shCoeffs, sizeof(float) * coeffs.size());
+    }
     mAllOrdersData = GPU::ShaderData(allOrders.data(), GPU::Binding::allOrders, sizeof(float) * allOrders.size());
-    mSphereVerticesData = GPU::ShaderData(mSphere->GetPoints().data(), GPU::Binding::sphereVertices, sizeof(glm::vec4) * mSphere->GetPoints().size());
-    mSphereIndicesData = GPU::ShaderData(mSphere->GetIndices().data(), GPU::Binding::sphereIndices, sizeof(unsigned int) * mSphere->GetIndices().size());
     mSphereInfoData = GPU::ShaderData(&sphereData, GPU::Binding::sphereInfo, sizeof(SphereData));
-    mGridInfoData = GPU::ShaderData(&gridData, GPU::Binding::gridInfo, sizeof(GridData));
-    mAllMaxAmplitudeData = GPU::ShaderData(allMaxAmplitude.data(), GPU::Binding::allMaxAmplitude, sizeof(float) * allMaxAmplitude.size());
 
     // push all data to GPU
     mSphHarmCoeffsData.ToGPU();
-    mSphHarmFuncsData.ToGPU();
     mAllOrdersData.ToGPU();
-    mSphereVerticesData.ToGPU();
-    mSphereIndicesData.ToGPU();
     mSphereInfoData.ToGPU();
-    mAllSpheresNormalsData.ToGPU();
-    mGridInfoData.ToGPU();
-    mAllRadiisData.ToGPU();
-    mAllMaxAmplitudeData.ToGPU();
 }
 
-template <typename T>
-GLuint SHField::genVBO(const std::vector<T>& data) const
+SHField::SphereData SHField::getSphereData(const Primitive::Sphere& sphere) const
 {
-    GLuint vbo;
-    glCreateBuffers(1, &vbo);
-    glNamedBufferData(vbo, data.size() * sizeof(T), &data[0], GL_STATIC_DRAW);
-    return vbo;
+    SphereData sphereData;
+    sphereData.NumVertices = static_cast<unsigned int>(sphere.GetPoints().size());
+    sphereData.NumIndices = static_cast<unsigned int>(sphere.GetIndices().size());
+    sphereData.IsNormalized = mState->Sphere.IsNormalized.Get();
+    sphereData.MaxOrder = sphere.GetMaxSHOrder();
+    sphereData.SH0threshold = mState->Sphere.SH0Threshold.Get();
+    sphereData.Scaling = mState->Sphere.Scaling.Get();
+    sphereData.NbCoeffs = getNbValuesPerVoxel();
+    sphereData.FadeIfHidden = mState->Sphere.FadeIfHidden.Get();
+    sphereData.ColorMapMode = mState->Sphere.ColorMapMode.Get();
+    return sphereData;
 }
 
-void SHField::setSliceIndex(glm::vec3 prevIndices, glm::vec3 newIndices)
+void SHField::setSliceIndex(glm::vec3, glm::vec3 newIndices)
 {
-    mIsSliceDirty.x = prevIndices.x != newIndices.x;
-    mIsSliceDirty.y = prevIndices.y != newIndices.y;
-    mIsSliceDirty.z = prevIndices.z != newIndices.z;
+    // The deformation is scheduled by the next draw. Requests made in
+    // the meantime replace this one.
+    mRequestedSlices = glm::ivec3(newIndices);
+}
 
-    if(mIsSliceDirty.x || mIsSliceDirty.y || mIsSliceDirty.z)
-    {
-        glm::ivec4 sliceIndices = glm::ivec4(newIndices, 0);
-        mGridInfoData.Update(sizeof(glm::ivec4), sizeof(glm::ivec4), &sliceIndices);
-        scaleSpheres();
-    }
+void SHField::setSphereResolution(int, int resolution)
+{
+    // The sphere is built in the background by the next draws. Requests
+    // made in the meantime replace this one.
+    mRequestedResolution = resolution;
 }
 
 void SHField::setNormalized(bool previous, bool isNormalized)
@@ -266,6 +681,7 @@ void SHField::setNormalized(bool previous, bool isNormalized)
     {
         unsigned int isNormalizedInt = isNormalized ? 1 : 0;
         mSphereInfoData.Update(sizeof(unsigned int)*2, sizeof(unsigned int), &isNormalizedInt);
+        updateProgramPipeline();
     }
 }
 
@@ -273,7 +689,8 @@ void SHField::setColorMapMode(int previous, int mode)
 {
     if(previous != mode)
     {
-        mSphereInfoData.Update(6*sizeof(unsigned int) + 2*sizeof(float), sizeof(unsigned int), &mode);       
+        mSphereInfoData.Update(6*sizeof(unsigned int) + 2*sizeof(float), sizeof(unsigned int), &mode);
+        updateProgramPipeline();
     }
 }
 
@@ -305,6 +722,7 @@ void SHField::setFadeIfHidden(bool previous, bool fadeEnabled)
         mSphereInfoData.Update(5*sizeof(unsigned int) + 2*sizeof(float),
                                sizeof(unsigned int),
                                &uintFadeEnabled);
+        updateProgramPipeline();
     }
 }
 
@@ -329,45 +747,366 @@ void SHField::setVisibleSlices(State::CameraMode previous, State::CameraMode nex
                 isVisible = glm::ivec4(1, 1, 1, 0);
                 break;
         }
-        mGridInfoData.Update(2*sizeof(glm::ivec4), sizeof(glm::ivec4), &isVisible);
+        mGridData.IsVisible = isVisible;
     }
 }
 
 void SHField::drawSpecific()
 {
+    updateResidentBricks();
+    updateSphereResolution();
+    uploadGridData(mGridData);
+    selectLevelsOfDetail();
+    scaleSpheres();
+    uploadGridData(mGridData);
     glBindVertexArray(mVAO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndicesBO);
-    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mIndirectBO);
-    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
-                                (GLvoid*)0, static_cast<int>(mIndirectCmd.size()),
-                                0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndicesBO.GetID());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mIndirectBO.GetID());
+
+    // Each plane is drawn from its front buffer, glyphs of tiles that
+    // are not deformed are hidden.
+    for(unsigned int plane = 0; plane < NB_PLANES; ++plane)
+    {
+        if(mGridData.IsVisible[plane] == 0)
+        {
+            continue;
+        }
+        const unsigned int front = mFrontBuffers[plane];
+        const auto& tileNbCoeffs = mTileNbCoeffs[plane][front];
+        mAllRadiisData[front].Bind();
+        mAllSpheresNormalsData[front].Bind();
+        mAllMaxAmplitudeData[front].Bind();
+        GPU::StreamRing::Instance().Bind(GPU::Binding::tileValidity, tileNbCoeffs.data(),
+                                         sizeof(GLuint) * tileNbCoeffs.size());
+        const size_t offset = getFirstSphere(plane) * sizeof(DrawElementsIndirectCommand);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                    reinterpret_cast<const GLvoid*>(offset),
+                                    static_cast<int>(getNbSpheres(plane)), 0);
+    }
 }
 
 void SHField::scaleSpheres()
 {
+    Utilities::ProfilerZone zone("SH deformation");
+
+    // Swap the planes whose back buffer is ready.
+    bool isPlaneSwapped = false;
+    for(unsigned int plane = 0; plane < NB_PLANES; ++plane)
+    {
+        GLsync& fence = mDeformationFences[plane];
+        if(fence == nullptr || glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            continue;
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+        mFrontBuffers[plane] = 1 - mFrontBuffers[plane];
+        mGridData.SliceIndices[plane] = mBufferSlices[plane][mFrontBuffers[plane]];
+        isPlaneSwapped = true;
+    }
+    if(isPlaneSwapped)
+    {
+        // The deformation is complete, the barrier only makes its
+        // writes visible to the draws and does not stall.
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
     glUseProgram(mComputeShader.ID());
-    if(mIsSliceDirty.x)
+    for(unsigned int plane = 0; plane < NB_PLANES; ++plane)
+    {
+        if(mDeformationFences[plane] == nullptr)
+        {
+            scaleSpheres(plane);
+        }
+    }
+    glUseProgram(0);
+}
+
+void SHField::scaleSpheres(unsigned int sliceId)
+{
+    // Only the latest requested slice is deformed, slices skipped while
+    // scrolling are never computed.
+    const int slice = mRequestedSlices[sliceId];
+    const unsigned int nbCoeffs = getNbValuesPerVoxel();
+    const unsigned int front = mFrontBuffers[sliceId];
+    const unsigned int back = 1 - front;
+    const bool isFrontSlice = mBufferSlices[sliceId][front] == slice;
+    const auto& frontNbCoeffs = mTileNbCoeffs[sliceId][front];
+    auto& backNbCoeffs = mTileNbCoeffs[sliceId][back];
+
+    // The main view and the magnifier see different tiles, the tiles of
+    // the slice seen by either view are deformed. Tiles never seen are
+    // left stale until they come in view.
+    auto& seenTiles = mSeenTiles[sliceId];
+    if(mSeenTilesSlices[sliceId] != slice)
     {
-        scaleSpheres(0, mNbSpheresX);
-        mIsSliceDirty.x = false;
+        std::fill(seenTiles.begin(), seenTiles.end(), false);
+        mSeenTilesSlices[sliceId] = slice;
     }
-    if(mIsSliceDirty.y)
+    for(const GLuint tile : getTilesInView(sliceId))
     {
-        scaleSpheres(1, mNbSpheresY);
-        mIsSliceDirty.y = false;
+        seenTiles[tile] = true;
     }
-    if(mIsSliceDirty.z)
+    bool hasStaleTiles = false;
+    for(GLuint tile = 0; tile < seenTiles.size(); ++tile)
+    {
+        hasStaleTiles |= seenTiles[tile] && (!isFrontSlice || frontNbCoeffs[tile] < nbCoeffs);
+    }
+    mHasStaleTiles[sliceId] = hasStaleTiles && mGridData.IsVisible[sliceId] != 0;
+    if(!mHasStaleTiles[sliceId])
+    {
+        return;
+    }
+
+    if(mBufferSlices[sliceId][back] != slice)
     {
-        scaleSpheres(2, mNbSpheresZ);
-        mIsSliceDirty.z = false;
+        std::fill(backNbCoeffs.begin(), backNbCoeffs.end(), 0);
+        mBufferSlices[sliceId][back] = slice;
+    }
+
+    // The back buffer gets every tile at least as refined as in the
+    // front buffer. Missing seen tiles get a preview from the low order
+    // bands, previews get the remaining bands, other tiles are copied.
+    std::map<std::pair<GLuint, GLuint>, std::vector<GLuint>> passes;
+    for(GLuint tile = 0; tile < seenTiles.size(); ++tile)
+    {
+        const GLuint frontCoeffs = isFrontSlice ? frontNbCoeffs[tile] : 0;
+        GLuint targetCoeffs = frontCoeffs;
+        if(seenTiles[tile])
+        {
+            targetCoeffs = frontCoeffs == 0 ? mNbPreviewCoeffs : nbCoeffs;
+        }
+        if(targetCoeffs == 0 || backNbCoeffs[tile] >= targetCoeffs)
+        {
+            continue;
+        }
+        passes[std::make_pair(frontCoeffs, targetCoeffs)].push_back(tile);
+        backNbCoeffs[tile] = targetCoeffs;
+    }
+
+    if(passes.empty())
+    {
+        // The back buffer is already ahead of the front buffer for every tile.
+        mFrontBuffers[sliceId] = back;
+        mGridData.SliceIndices[sliceId] = slice;
+        return;
+    }
+
+    GridData gridData = mGridData;
+    gridData.SliceIndices[sliceId] = slice;
+    gridData.CurrentSlice = sliceId;
+    uploadGridData(gridData);
+
+    mAllRadiisData[back].Bind();
+    mAllSpheresNormalsData[back].Bind();
+    mAllMaxAmplitudeData[back].Bind();
+    mAllRadiisData[front].Bind(GPU::Binding::previousRadiis);
+    mAllSpheresNormalsData[front].Bind(GPU::Binding::previousSpheresNormals);
+    mAllMaxAmplitudeData[front].Bind(GPU::Binding::previousMaxAmplitude);
+    for(const auto& pass : passes)
+    {
+        scaleTiles(pass.first.first, pass.first.second, pass.second);
+    }
+    mDeformationFences[sliceId] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void SHField::scaleTiles(unsigned int firstCoeff, unsigned int lastCoeff,
+                         const std::vector<GLuint>& tiles)
+{
+    DeformationData deformationData;
+    deformationData.FirstCoeff = firstCoeff;
+    deformationData.LastCoeff = lastCoeff;
+    auto& ring = GPU::StreamRing::Instance();
+    ring.Bind(GPU::Binding::deformationInfo, &deformationData, sizeof(DeformationData));
+    ring.Bind(GPU::Binding::tileList, tiles.data(), sizeof(GLuint) * tiles.size());
+
+    // One work group per voxel of a tile, one row of work groups per tile.
+    glDispatchCompute(TILE_SIZE * TILE_SIZE, static_cast<GLuint>(tiles.size()), 1);
+}
+
+std::vector<GLuint> SHField::getTilesInView(unsigned int sliceId) const
+{
+    std::vector<GLuint> tiles;
+    if(mGridData.IsVisible[sliceId] == 0)
+    {
+        return tiles;
+    }
+
+    // Glyphs are centered on voxels, at most one scaled unit sphere away.
+    const glm::ivec3 dims = glm::ivec3(mGridData.VolumeShape);
+    const glm::ivec2 axes = getPlaneAxes(sliceId);
+    const float margin = std::max(mState->Sphere.Scaling.Get(), 0.5f);
+    const float sliceCenter = static_cast<float>(mRequestedSlices[sliceId] - dims[sliceId] / 2);
+    glm::vec3 boxMin(0.0f), boxMax(0.0f);
+    boxMin[sliceId] = sliceCenter - margin;
+    boxMax[sliceId] = sliceCenter + margin;
+    for(GLuint row = 0; row < mNbTiles[sliceId].y; ++row)
+    {
+        const int firstV = static_cast<int>(row * TILE_SIZE);
+        const int lastV = std::min(firstV + static_cast<int>(TILE_SIZE), dims[axes.y]) - 1;
+        boxMin[axes.y] = static_cast<float>(firstV - dims[axes.y] / 2) - margin;
+        boxMax[axes.y] = static_cast<float>(lastV - dims[axes.y] / 2) + margin;
+        for(GLuint column = 0; column < mNbTiles[sliceId].x; ++column)
+        {
+            const int firstU = static_cast<int>(column * TILE_SIZE);
+            const int lastU = std::min(firstU + static_cast<int>(TILE_SIZE), dims[axes.x]) - 1;
+            boxMin[axes.x] = static_cast<float>(firstU - dims[axes.x] / 2) - margin;
+            boxMax[axes.x] = static_cast<float>(lastU - dims[axes.x] / 2) + margin;
+            if(isBoxInFrustum(mModelViewProjection, boxMin, boxMax))
+            {
+                tiles.push_back(row * mNbTiles[sliceId].x + column);
+            }
+        }
+    }
+    return tiles;
+}
+
+glm::ivec2 SHField::getPlaneAxes(unsigned int sliceId) const
+{
+    // Same order as the flat indices of the spheres of each plane.
+    switch(sliceId)
+    {
+    case 0:
+        return glm::ivec2(2, 1);
+    case 1:
+        return glm::ivec2(0, 2);
+    default:
+        return glm::ivec2(0, 1);
+    }
+}
+
+unsigned int SHField::getNbSpheres(unsigned int sliceId) const
+{
+    switch(sliceId)
+    {
+    case 0:
+        return mNbSpheresX;
+    case 1:
+        return mNbSpheresY;
+    default:
+        return mNbSpheresZ;
+    }
+}
+
+unsigned int SHField::getFirstSphere(unsigned int sliceId) const
+{
+    // The glyph buffers contain the Z, X and Y planes, in that order.
+    switch(sliceId)
+    {
+    case 0:
+        return mNbSpheresZ;
+    case 1:
+        return mNbSpheresZ + mNbSpheresX;
+    default:
+        return 0;
+    }
+}
+
+void SHField::selectLevelsOfDetail()
+{
+    Utilities::ProfilerZone zone("SH level of detail");
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    LevelOfDetailData lodData;
+    lodData.ViewportHeight = static_cast<float>(viewport[3]);
+    lodData.LevelZeroRadius = LEVEL_ZERO_RADIUS;
+    lodData.AggregateRadius = AGGREGATE_RADIUS;
+    lodData.NbLevels = static_cast<unsigned int>(mSphere->GetLevelFirstIndices().size() - 1);
+    lodData.QuadFirstIndex = static_cast<unsigned int>(mSphere->GetLevelFirstIndices().back());
+    lodData.FirstSphere = 0;
+    lodData.NbSpheres = 0;
+    // The vertex shader reads the aggregation radius, even when no plane
+    // is in view.
+    GPU::StreamRing::Instance().Bind(GPU::Binding::lodInfo, &lodData, sizeof(LevelOfDetailData));
+    mLevelsData.Bind();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, static_cast<GLuint>(GPU::Binding::drawCommands),
+                     mIndirectBO.GetID());
+
+    // Glyphs of hidden or culled planes are not seen, their commands
+    // are updated when the plane comes back in view.
+    glUseProgram(mLevelOfDetailShader.ID());
+    for(unsigned int plane = 0; plane < NB_PLANES; ++plane)
+    {
+        if(getTilesInView(plane).empty())
+        {
+            continue;
+        }
+        lodData.FirstSphere = getFirstSphere(plane);
+        lodData.NbSpheres = getNbSpheres(plane);
+        GPU::StreamRing::Instance().Bind(GPU::Binding::lodInfo, &lodData, sizeof(LevelOfDetailData));
+        glDispatchCompute((lodData.NbSpheres + LEVEL_OF_DETAIL_GROUP_SIZE - 1) / LEVEL_OF_DETAIL_GROUP_SIZE, 1, 1);
     }
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
     glUseProgram(0);
+
+    // The draws of this model read the commands written by the pass, as
+    // commands and from the vertex shader for aggregated glyphs.
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+const std::vector<float>& SHField::getSHCoeffs() const
+{
+    if(mLowRankVolume != nullptr)
+    {
+        return mLowRankVolume->GetValues();
+    }
+    return mState->FODFImage.Get().GetVoxelData();
+}
+
+unsigned int SHField::getNbValuesPerVoxel() const
+{
+    if(mLowRankVolume != nullptr)
+    {
+        return mLowRankVolume->GetNbValuesPerVoxel();
+    }
+    return mState->FODFImage.Get().GetDims().w;
+}
+
+glm::ivec3 SHField::getNbBricks() const
+{
+    const glm::ivec3 dims = glm::ivec3(mState->FODFImage.Get().GetDims());
+    return (dims + BRICK_SIZE - 1) / BRICK_SIZE;
+}
+
+void SHField::updateResidentBricks()
+{
+    if(mBrickCache == nullptr)
+    {
+        return;
+    }
+    Utilities::ProfilerZone zone("SH brick residency");
+
+    // Bricks are as thick as BRICK_SIZE slices along the plane normal.
+    const glm::ivec3 nbBricks = getNbBricks();
+    std::vector<GLuint> bricks;
+    for(unsigned int plane = 0; plane < NB_PLANES; ++plane)
+    {
+        const glm::ivec2 axes = getPlaneAxes(plane);
+        const std::array<int, 3> slices = {mBufferSlices[plane][0], mBufferSlices[plane][1],
+                                           mRequestedSlices[plane]};
+        for(const int slice : slices)
+        {
+            if(slice < 0)
+            {
+                continue;
+            }
+            glm::ivec3 brick;
+            brick[plane] = slice / BRICK_SIZE;
+            for(brick[axes.y] = 0; brick[axes.y] < nbBricks[axes.y]; ++brick[axes.y])
+            {
+                for(brick[axes.x] = 0; brick[axes.x] < nbBricks[axes.x]; ++brick[axes.x])
+                {
+                    bricks.push_back((brick.z * nbBricks.y + brick.y) * nbBricks.x + brick.x);
+                }
+            }
+        }
+    }
+    mBrickCache->MakeResident(bricks);
+    mBrickCache->Bind();
 }
 
-void SHField::scaleSpheres(unsigned int sliceId, unsigned int nbSpheres)
+void SHField::uploadGridData(const GridData& gridData)
 {
-    mGridInfoData.Update(3*sizeof(glm::ivec4), sizeof(unsigned int), &sliceId);
-    glDispatchCompute(nbSpheres, 1, 1);
+    GPU::StreamRing::Instance().Bind(GPU::Binding::gridInfo, &gridData, sizeof(GridData));
 }
 } // namespace Slicer
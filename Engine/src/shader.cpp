@@ -1,4 +1,5 @@
 #include "shader.h"
+#include "shader_cache.h"
 #include "utils.hpp"
 #include <algorithm>
 #include <cstring>
@@ -6,7 +7,7 @@
 
 namespace
 {
-const int NUM_SHADER_INCLUDES = 7;
+const int NUM_SHADER_INCLUDES = 8;
 const char* SHADER_INCLUDE_PATHS[NUM_SHADER_INCLUDES] = {
     "/include/camera_util.glsl",
     "/include/orthogrid_util.glsl",
@@ -14,7 +15,8 @@ const char* SHADER_INCLUDE_PATHS[NUM_SHADER_INCLUDES] = {
     "/include/sphere_util.glsl",
     "/include/color_maps.glsl",
     "/include/vert_util.glsl",
-    "/include/frag_util.glsl"
+    "/include/frag_util.glsl",
+    "/include/lod_util.glsl"
 };
 }
 
@@ -24,9 +26,40 @@ namespace GPU
 {
 ShaderProgram::ShaderProgram(const std::string& filePath,
                              const GLenum shaderType)
+:ShaderProgram(filePath, shaderType, {})
+{
+}
+
+ShaderProgram::ShaderProgram(const std::string& filePath,
+                             const GLenum shaderType,
+                             const std::vector<std::string>& defines)
 :mShaderType(shaderType)
 {
-    const std::string strShader = readFile(filePath);
+    std::string strShader = readFile(filePath);
+    if(!defines.empty())
+    {
+        // Definitions must follow the version directive, the line
+        // directive keeps compiler messages aligned with the file.
+        std::string strDefines;
+        for(const auto& define : defines)
+        {
+            strDefines += "#define " + define + "\n";
+        }
+        strDefines += "#line 2\n";
+        const size_t versionEnd = strShader.find('\n', strShader.find("#version"));
+        strShader.insert(versionEnd == std::string::npos ? strShader.size() : versionEnd + 1,
+                         strDefines);
+    }
+
+    // Restore the linked program from the cache if possible.
+    const std::string cacheKey = ShaderCache::ComputeKey(shaderType, strShader,
+                                                         mShaderIncludesHash);
+    this->mProgramID = ShaderCache::LoadProgram(cacheKey);
+    if(this->mProgramID != 0)
+    {
+        return;
+    }
+
     GLint lenShader[1] = { static_cast<GLint>(strShader.length()) };
     const GLchar* strShaderC_str = strShader.c_str();
 
@@ -40,13 +73,21 @@ ShaderProgram::ShaderProgram(const std::string& filePath,
 
     this->mProgramID = glCreateProgram();
     glProgramParameteri(this->mProgramID, GL_PROGRAM_SEPARABLE, GL_TRUE);
+    glProgramParameteri(this->mProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glAttachShader(this->mProgramID, shaderID);
     glLinkProgram(this->mProgramID);
     assertProgramLinkingSuccess(this->mProgramID);
+
+    // The shader object is not needed once the program is linked.
+    glDetachShader(this->mProgramID, shaderID);
+    glDeleteShader(shaderID);
+
+    ShaderCache::StoreProgram(cacheKey, this->mProgramID);
 }
 
 void ShaderProgram::CreateFilesystemForInclude()
 {
+    mShaderIncludesHash = ShaderCache::FNV_OFFSET_BASIS;
     for(int i = 0; i < NUM_SHADER_INCLUDES; ++i)
     {
         const auto pathName = SHADER_INCLUDE_PATHS[i];
@@ -60,6 +101,10 @@ void ShaderProgram::CreateFilesystemForInclude()
         glNamedStringARB(GL_SHADER_INCLUDE_ARB, pathNameLen,
                          pathName, static_cast<int>(strInclude.length()),
                          strInclude.c_str());
+        // Programs depend on the includes, they are part of the cache key.
+        mShaderIncludesHash = ShaderCache::Hash(pathName, pathNameLen, mShaderIncludesHash);
+        mShaderIncludesHash = ShaderCache::Hash(strInclude.data(), strInclude.length(),
+                                                mShaderIncludesHash);
         mShaderIncludePaths.push_back(pathName);
         mShaderIncludeLengths.push_back(static_cast<int>(pathNameLen));
     }
@@ -0,0 +1,172 @@
+#include <shader_cache.h>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <cstdio>
+
+namespace
+{
+const std::string SHADER_CACHE_DIR = "/shader_cache";
+const uint32_t CACHE_FILE_MAGIC = 0x42524d44; // "DMRB"
+const uint32_t CACHE_FILE_VERSION = 1;
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+/// Header of a cache file, followed by the program binary.
+struct CacheFileHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t Format;
+    uint32_t Size;
+};
+}
+
+namespace Slicer
+{
+namespace GPU
+{
+std::string ShaderCache::ComputeKey(const GLenum shaderType,
+                                    const std::string& source,
+                                    const uint64_t includesHash)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for(const GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+    {
+        const char* str = reinterpret_cast<const char*>(glGetString(name));
+        if(str != nullptr)
+        {
+            hash = Hash(str, std::char_traits<char>::length(str), hash);
+        }
+    }
+    hash = Hash(&shaderType, sizeof(GLenum), hash);
+    hash = Hash(&includesHash, sizeof(uint64_t), hash);
+    hash = Hash(source.data(), source.size(), hash);
+
+    char key[17];
+    std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash));
+    return std::string(key);
+}
+
+GLuint ShaderCache::LoadProgram(const std::string& key)
+{
+    if(!isSupported())
+    {
+        return 0;
+    }
+
+    std::ifstream file(getPath(key), std::ios::binary);
+    if(!file.is_open())
+    {
+        return 0;
+    }
+
+    CacheFileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(CacheFileHeader));
+    if(!file || header.Magic != CACHE_FILE_MAGIC || header.Version != CACHE_FILE_VERSION)
+    {
+        return 0;
+    }
+    std::vector<char> binary(header.Size);
+    file.read(binary.data(), header.Size);
+    if(!file)
+    {
+        return 0;
+    }
+
+    // The separable flag is not part of the binary.
+    const GLuint program = glCreateProgram();
+    glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+    glProgramBinary(program, header.Format, binary.data(), header.Size);
+
+    GLint success = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if(success != GL_TRUE)
+    {
+        // Rejected by the driver, the program is compiled again.
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ShaderCache::StoreProgram(const std::string& key, const GLuint program)
+{
+    if(!isSupported())
+    {
+        return;
+    }
+
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if(size <= 0)
+    {
+        return;
+    }
+
+    std::vector<char> binary(size);
+    GLenum format = 0;
+    GLsizei length = 0;
+    glGetProgramBinary(program, size, &length, &format, binary.data());
+    if(length <= 0)
+    {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(DMRI_EXPLORER_BINARY_DIR + SHADER_CACHE_DIR, error);
+    if(error)
+    {
+        return;
+    }
+
+    // Written to a temporary file first so that concurrent instances
+    // never read a partially written binary.
+    const std::string path = getPath(key);
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!file.is_open())
+        {
+            return;
+        }
+        const CacheFileHeader header = {CACHE_FILE_MAGIC, CACHE_FILE_VERSION,
+                                        static_cast<uint32_t>(format),
+                                        static_cast<uint32_t>(length)};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(CacheFileHeader));
+        file.write(binary.data(), length);
+        if(!file)
+        {
+            return;
+        }
+    }
+    std::filesystem::rename(tmpPath, path, error);
+}
+
+uint64_t ShaderCache::Hash(const void* data, size_t size, uint64_t hash)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+bool ShaderCache::isSupported()
+{
+    static const bool isSupported = []()
+    {
+        GLint nbFormats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nbFormats);
+        return nbFormats > 0;
+    }();
+    return isSupported;
+}
+
+std::string ShaderCache::getPath(const std::string& key)
+{
+    return DMRI_EXPLORER_BINARY_DIR + SHADER_CACHE_DIR + "/" + key + ".bin";
+}
+} // namespace GPU
+} // namespace Slicer
@@ -1,78 +1,202 @@
 #include <shader_data.h>
+#include <memory_registry.h>
+
+namespace
+{
+std::string getBindingName(Slicer::GPU::Binding binding)
+{
+    using Slicer::GPU::Binding;
+    switch(binding)
+    {
+    case Binding::allRadiis:
+        return "allRadiis";
+    case Binding::allSpheresNormals:
+        return "allSpheresNormals";
+    case Binding::instanceTransform:
+        return "instanceTransform";
+    case Binding::shCoeffs:
+        return "shCoeffs";
+    case Binding::shFunctions:
+        return "shFunctions";
+    case Binding::sphereVertices:
+        return "sphereVertices";
+    case Binding::sphereIndices:
+        return "sphereIndices";
+    case Binding::sphereInfo:
+        return "sphereInfo";
+    case Binding::gridInfo:
+        return "gridInfo";
+    case Binding::camera:
+        return "camera";
+    case Binding::modelTransform:
+        return "modelTransform";
+    case Binding::allOrders:
+        return "allOrders";
+    case Binding::allMaxAmplitude:
+        return "allMaxAmplitude";
+    case Binding::tensorValues:
+        return "tensorValues";
+    case Binding::coefsValues:
+        return "coefsValues";
+    case Binding::pddsValues:
+        return "pddsValues";
+    case Binding::faValues:
+        return "faValues";
+    case Binding::mdValues:
+        return "mdValues";
+    case Binding::adValues:
+        return "adValues";
+    case Binding::rdValues:
+        return "rdValues";
+    case Binding::deformationInfo:
+        return "deformationInfo";
+    case Binding::previousRadiis:
+        return "previousRadiis";
+    case Binding::tileList:
+        return "tileList";
+    case Binding::tileValidity:
+        return "tileValidity";
+    case Binding::previousSpheresNormals:
+        return "previousSpheresNormals";
+    case Binding::previousMaxAmplitude:
+        return "previousMaxAmplitude";
+    case Binding::drawCommands:
+        return "drawCommands";
+    case Binding::lodLevels:
+        return "lodLevels";
+    case Binding::lodInfo:
+        return "lodInfo";
+    case Binding::brickPageTable:
+        return "brickPageTable";
+    case Binding::none:
+        return "none";
+    }
+    return "binding " + std::to_string(static_cast<int>(binding));
+}
+}
 
 namespace Slicer
 {
 namespace GPU
 {
 ShaderData::ShaderData()
-:mBinding(Binding::none)
+:mRange()
+,mBinding(Binding::none)
 ,mIsDirty(true)
-,mSSBO(0)
-,mIsInit(false)
-,mUsage(GL_DYNAMIC_DRAW)
+,mOwner(Utilities::MemoryRegistry::Instance().GetCurrentOwner())
+,mMemoryId(0)
 {
 };
 
-ShaderData::ShaderData(void* data, Binding binding, size_t sizeofT)
-:mBinding(binding)
-,mIsDirty(true)
-,mIsInit(true)
-,mUsage(GL_DYNAMIC_DRAW)
+ShaderData::ShaderData(const void* data, Binding binding, size_t sizeofT)
+:ShaderData(binding)
 {
-    glCreateBuffers(1, &mSSBO);
-    glNamedBufferData(mSSBO, sizeofT, data, mUsage);
+    allocate(sizeofT);
+    glNamedBufferSubData(mRange.Buffer, mRange.Offset, sizeofT, data);
 };
 
-ShaderData::ShaderData(void* data, Binding binding, size_t sizeofT, GLenum usage)
-:mBinding(binding)
-,mIsDirty(true)
-,mIsInit(true)
-,mUsage(usage)
+ShaderData::ShaderData(Binding binding)
+:ShaderData()
 {
-    glCreateBuffers(1, &mSSBO);
-    glNamedBufferData(mSSBO, sizeofT, data, usage);
-};
+    mBinding = binding;
+}
 
-ShaderData::ShaderData(Binding binding, GLenum usage)
-:mBinding(binding)
-,mIsDirty(true)
-,mIsInit(false)
-,mUsage(usage)
+ShaderData::ShaderData(Binding binding, size_t sizeofT)
+:ShaderData(binding)
 {
-    glCreateBuffers(1, &mSSBO);
+    allocate(sizeofT);
 }
 
-ShaderData::ShaderData(Binding binding)
-:mBinding(binding)
-,mIsDirty(true)
-,mIsInit(false)
-,mUsage(GL_DYNAMIC_DRAW)
+ShaderData::ShaderData(ShaderData&& other) noexcept
+:mRange(other.mRange)
+,mBinding(other.mBinding)
+,mIsDirty(other.mIsDirty)
+,mOwner(std::move(other.mOwner))
+,mMemoryId(other.mMemoryId)
 {
-    glCreateBuffers(1, &mSSBO);
+    other.mRange = BufferRange();
+    other.mMemoryId = 0;
 }
 
-void ShaderData::Update(GLintptr offset, GLsizeiptr size, void* data)
+ShaderData& ShaderData::operator=(ShaderData&& other) noexcept
 {
-    mIsDirty = true;
-    if(!mIsInit)
+    if(this != &other)
     {
-        glNamedBufferData(mSSBO, size, data, mUsage);
+        release();
+        mRange = other.mRange;
+        mBinding = other.mBinding;
+        mIsDirty = other.mIsDirty;
+        mOwner = std::move(other.mOwner);
+        mMemoryId = other.mMemoryId;
+        other.mRange = BufferRange();
+        other.mMemoryId = 0;
     }
-    else
+    return *this;
+}
+
+ShaderData::~ShaderData()
+{
+    release();
+}
+
+void ShaderData::Update(GLintptr offset, GLsizeiptr size, const void* data)
+{
+    mIsDirty = true;
+    if(mRange.Buffer == 0 || mRange.Size < offset + size)
     {
-        glNamedBufferSubData(mSSBO, offset, size, data);
+        release();
+        allocate(offset + size);
     }
+    glNamedBufferSubData(mRange.Buffer, mRange.Offset + offset, size, data);
 };
 
 void ShaderData::ToGPU()
 {
     // Copy SSBO data to GPU
-    if(mIsDirty)
+    if(mIsDirty && mRange.Buffer != 0)
     {
         GLuint index = static_cast<GLuint>(mBinding);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, mSSBO);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, index, mRange.Buffer,
+                          mRange.Offset, mRange.Size);
         mIsDirty = false;
     }
 };
+
+void ShaderData::Bind()
+{
+    mIsDirty = true;
+    ToGPU();
+}
+
+void ShaderData::Bind(Binding binding) const
+{
+    if(mRange.Buffer != 0)
+    {
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, static_cast<GLuint>(binding),
+                          mRange.Buffer, mRange.Offset, mRange.Size);
+    }
+}
+
+void ShaderData::allocate(GLsizeiptr size)
+{
+    mRange = BufferArena::Instance().Allocate(size);
+    mMemoryId = Utilities::MemoryRegistry::Instance().Register(
+        Utilities::MemoryRegistry::Kind::gpuBuffer, mOwner, getBindingName(mBinding),
+        static_cast<size_t>(size));
+}
+
+void ShaderData::release()
+{
+    if(mRange.Buffer != 0)
+    {
+        BufferArena::Instance().Free(mRange);
+        mRange = BufferRange();
+    }
+    if(mMemoryId != 0)
+    {
+        Utilities::MemoryRegistry::Instance().Release(mMemoryId);
+        mMemoryId = 0;
+    }
+}
 } // namespace GPU
 } // namespace Slicer
@@ -46,11 +46,13 @@ namespace Slicer
 namespace Primitive
 {
 Sphere::Sphere()
-:mResolution(0)
+:mPoints()
 ,mIndices()
-,mPoints()
-,mSHBasis(nullptr)
+,mLevelIndices()
+,mLevelFirstIndices()
 ,mSphHarmFunc()
+,mSHBasis(nullptr)
+,mResolution(0)
 {
     mSHBasis.reset(new SH::DescoteauxBasis(DEFAULT_NB_COEFFS));
     genUnitIcosahedron();
@@ -58,11 +60,13 @@ Sphere::Sphere()
 
 Sphere::Sphere(unsigned int resolution,
                unsigned int nbSHCoeffs)
-:mResolution(resolution)
+:mPoints()
 ,mIndices()
-,mPoints()
-,mSHBasis()
+,mLevelIndices()
+,mLevelFirstIndices()
 ,mSphHarmFunc()
+,mSHBasis()
+,mResolution(resolution)
 {
     mSHBasis.reset(new SH::DescoteauxBasis(nbSHCoeffs));
     genUnitIcosahedron();
@@ -76,6 +80,8 @@ Sphere& Sphere::operator=(const Sphere& other)
     }
     mResolution = other.mResolution;
     mIndices = other.mIndices;
+    mLevelIndices = other.mLevelIndices;
+    mLevelFirstIndices = other.mLevelFirstIndices;
     mSHBasis = other.mSHBasis;
     mPoints = other.mPoints;
     mSphHarmFunc = other.mSphHarmFunc;
@@ -83,11 +89,13 @@ Sphere& Sphere::operator=(const Sphere& other)
 }
 
 Sphere::Sphere(const Sphere& other)
-:mResolution(other.mResolution)
+:mPoints(other.mPoints)
 ,mIndices(other.mIndices)
-,mSHBasis(other.mSHBasis)
-,mPoints(other.mPoints)
+,mLevelIndices(other.mLevelIndices)
+,mLevelFirstIndices(other.mLevelFirstIndices)
 ,mSphHarmFunc(other.mSphHarmFunc)
+,mSHBasis(other.mSHBasis)
+,mResolution(other.mResolution)
 {
 }
 
@@ -166,10 +174,15 @@ void Sphere::genUnitIcosahedron()
         mIndices.push_back(BASE_ICOSAHEDRON_INDICES[i]);
     }
 
-    // Subdivide icosahedron up to mResolution
+    // Subdivide icosahedron up to mResolution, keeping each level
+    mLevelFirstIndices.push_back(0);
+    mLevelIndices.insert(mLevelIndices.end(), mIndices.begin(), mIndices.end());
+    mLevelFirstIndices.push_back(mLevelIndices.size());
     for(unsigned int i = 0; i < mResolution; ++i)
     {
         subdivide();
+        mLevelIndices.insert(mLevelIndices.end(), mIndices.begin(), mIndices.end());
+        mLevelFirstIndices.push_back(mLevelIndices.size());
     }
 }
 
@@ -0,0 +1,114 @@
+#include <stream_ring.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace Slicer
+{
+namespace GPU
+{
+namespace
+{
+// Size of the region of each frame in flight. Per-frame data is a few
+// kilobytes, one range per camera, model and compute dispatch.
+const GLsizeiptr REGION_SIZE = 1024 * 1024;
+const GLuint64 FENCE_TIMEOUT_NS = 1000000000;
+}
+
+StreamRing& StreamRing::Instance()
+{
+    static StreamRing ring;
+    return ring;
+}
+
+StreamRing::StreamRing()
+:mStorage()
+,mMappedPtr(nullptr)
+,mAlignment(0)
+,mFences()
+,mCurrentRegion(0)
+,mRegionOffset(0)
+{
+    mFences.fill(nullptr);
+}
+
+void StreamRing::initialize()
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    mAlignment = std::max<GLsizeiptr>(alignment, 4);
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr size = REGION_SIZE * static_cast<GLsizeiptr>(mFences.size());
+    mStorage = GPU::Buffer(size, nullptr, flags, "per-frame ring");
+    mMappedPtr = static_cast<char*>(glMapNamedBufferRange(mStorage.GetID(), 0, size, flags));
+    mCurrentRegion = 0;
+    mRegionOffset = 0;
+}
+
+BufferRange StreamRing::Push(const void* data, GLsizeiptr size)
+{
+    if(mMappedPtr == nullptr)
+    {
+        initialize();
+    }
+    if(mRegionOffset + size > REGION_SIZE)
+    {
+        throw std::runtime_error("StreamRing::Push() exceeds the per-frame capacity.");
+    }
+    const GLintptr offset = mCurrentRegion * REGION_SIZE + mRegionOffset;
+    std::memcpy(mMappedPtr + offset, data, size);
+    mRegionOffset += (size + mAlignment - 1) / mAlignment * mAlignment;
+    return {mStorage.GetID(), offset, size};
+}
+
+void StreamRing::Bind(Binding binding, const void* data, GLsizeiptr size)
+{
+    const BufferRange range = Push(data, size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, static_cast<GLuint>(binding),
+                      range.Buffer, range.Offset, range.Size);
+}
+
+void StreamRing::EndFrame()
+{
+    if(mMappedPtr == nullptr)
+    {
+        return;
+    }
+    mFences[mCurrentRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    mCurrentRegion = (mCurrentRegion + 1) % mFences.size();
+    mRegionOffset = 0;
+
+    // The region was last used a few frames ago, the GPU is usually done with it.
+    GLsync& fence = mFences[mCurrentRegion];
+    if(fence != nullptr)
+    {
+        GLenum status = GL_TIMEOUT_EXPIRED;
+        while(status == GL_TIMEOUT_EXPIRED)
+        {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+void StreamRing::Clear()
+{
+    for(auto& fence : mFences)
+    {
+        if(fence != nullptr)
+        {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if(mMappedPtr != nullptr)
+    {
+        glUnmapNamedBuffer(mStorage.GetID());
+        mMappedPtr = nullptr;
+    }
+    mStorage = GPU::Buffer();
+}
+} // namespace GPU
+} // namespace Slicer
@@ -1,7 +1,20 @@
 #include <texture.h>
 #include <glad/glad.h>
 #include <timer.h>
+#include <memory_registry.h>
 #include <math.h>
+#include <cstring>
+#include <cmath>
+
+namespace
+{
+const unsigned int NB_PLANES = 3;
+const unsigned int NB_REGIONS_PER_PLANE = 2;
+
+// Intensity window of the background, robust to outliers.
+const float WINDOW_LOW_PERCENTILE = 0.5f;
+const float WINDOW_HIGH_PERCENTILE = 99.5f;
+}
 
 namespace Slicer
 {
@@ -9,13 +22,35 @@ Texture::Texture(const std::shared_ptr<ApplicationState>& state,
                  std::shared_ptr<CoordinateSystem> parent)
 :Model(state)
 ,mVAO(0)
-,mVerticesBO(0)
+,mVertexBO()
 ,mVertices()
-,mTextureCoordsBO(0)
+,mVolume()
 ,mTextureCoords()
-,mSliceBO(0)
 ,mSlice()
-,mData()
+,mDims()
+,mNbChannels(1)
+,mInternalFormat(GL_R16)
+,mPixelFormat(GL_RED)
+,mPixelType(GL_UNSIGNED_SHORT)
+,mTexelSize(0)
+,mIsStreaming(state->StreamBackground.Get())
+,mVolumeTexture(0)
+,mSliceTextures()
+,mStagingBO()
+,mStagingPtr(nullptr)
+,mRegionOffsets()
+,mRegionFences()
+,mNextRegion()
+,mRequestedSlices()
+,mScheduledSlices()
+,mIsPlaneBusy()
+,mWorker()
+,mJobsMutex()
+,mJobsCondition()
+,mPendingJobs()
+,mFinishedJobs()
+,mStopWorker(false)
+,mMemoryIds()
 {
     resetCS(std::shared_ptr<CoordinateSystem>(new CoordinateSystem(glm::mat4(1.0f), parent)));
     initializeModel();
@@ -24,6 +59,53 @@ Texture::Texture(const std::shared_ptr<ApplicationState>& state,
 
 Texture::~Texture()
 {
+    stopStreamingWorker();
+    for(auto& fences : mRegionFences)
+    {
+        for(auto& fence : fences)
+        {
+            if(fence != nullptr)
+            {
+                glDeleteSync(fence);
+            }
+        }
+    }
+    if(mStagingBO.GetID() != 0)
+    {
+        glUnmapNamedBuffer(mStagingBO.GetID());
+    }
+    if(mVAO != 0)
+    {
+        glDeleteVertexArrays(1, &mVAO);
+    }
+    if(mIsStreaming)
+    {
+        glDeleteTextures(NB_PLANES, mSliceTextures.data());
+    }
+    else if(mVolumeTexture != 0)
+    {
+        glDeleteTextures(1, &mVolumeTexture);
+    }
+    for(const size_t id : mMemoryIds)
+    {
+        Utilities::MemoryRegistry::Instance().Release(id);
+    }
+}
+
+bool Texture::HasPendingUpdates() const
+{
+    if(!mIsStreaming)
+    {
+        return false;
+    }
+    for(unsigned int plane = 0; plane < NB_PLANES; ++plane)
+    {
+        if(mIsPlaneBusy[plane] || mRequestedSlices[plane] != mScheduledSlices[plane])
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
 void Texture::updateApplicationStateAtInit()
@@ -32,13 +114,24 @@ void Texture::updateApplicationStateAtInit()
 
 void Texture::registerStateCallbacks()
 {
+    if(mIsStreaming)
+    {
+        mState->VoxelGrid.SliceIndices.RegisterCallback(
+            [this](glm::vec3 p, glm::vec3 n)
+            {
+                this->setSliceIndex(p, n);
+            }
+        );
+    }
 }
 
 
 void Texture::initProgramPipeline()
 {
     const std::string vsPath = DMRI_EXPLORER_BINARY_DIR + std::string("/shaders/texture_vert.glsl");
-    const std::string fsPath = DMRI_EXPLORER_BINARY_DIR + std::string("/shaders/texture_frag.glsl");
+    const std::string fsPath = DMRI_EXPLORER_BINARY_DIR + std::string(mIsStreaming ?
+                                                                      "/shaders/texture_slices_frag.glsl" :
+                                                                      "/shaders/texture_frag.glsl");
     std::vector<GPU::ShaderProgram> shaders;
 
     shaders.push_back(GPU::ShaderProgram(vsPath, GL_VERTEX_SHADER));
@@ -51,14 +144,35 @@ void Texture::initializeMembers()
 {
     const auto& image = mState->BackgroundImage.Get();
 
-    // copy image data because we need to normalize
-    mData = image.GetVoxelData();
-    const auto max = image.GetMax();
-    for(size_t i = 0; i < mData.size(); ++i)
+    // convert to a compact normalized format once, in parallel
     {
-        mData[i] = mData[i] / max;
+        Utilities::AutoTimer timer("Background conversion");
+        mVolume.reset(new NormalizedVolume(image, WINDOW_LOW_PERCENTILE,
+                                           WINDOW_HIGH_PERCENTILE,
+                                           *mState->WorkerPool));
     }
     const auto dims = image.GetDims();
+    mDims = dims;
+    mNbChannels = mVolume->GetNbChannels();
+    mTexelSize = mVolume->GetTexelSize();
+    switch(mVolume->GetFormat())
+    {
+    case NormalizedVolume::Format::r8:
+        mInternalFormat = GL_R8;
+        mPixelFormat = GL_RED;
+        mPixelType = GL_UNSIGNED_BYTE;
+        break;
+    case NormalizedVolume::Format::r16:
+        mInternalFormat = GL_R16;
+        mPixelFormat = GL_RED;
+        mPixelType = GL_UNSIGNED_SHORT;
+        break;
+    case NormalizedVolume::Format::rgb10a2:
+        mInternalFormat = GL_RGB10_A2;
+        mPixelFormat = GL_RGBA;
+        mPixelType = GL_UNSIGNED_INT_2_10_10_10_REV;
+        break;
+    }
 
     //Create 2 triangles to create a plan for texture
     //Plan XY
@@ -136,73 +250,322 @@ void Texture::initializeMembers()
     mSlice.push_back(glm::vec3(0.0f,1.0f,0.0f));
     mSlice.push_back(glm::vec3(0.0f,1.0f,0.0f));
 
-    //Create texture
-    unsigned int texture;
-    glCreateTextures(GL_TEXTURE_3D, 1, &texture);
-    glBindTexture(GL_TEXTURE_3D, texture);
-
-    auto type = GL_RGB;
-    if (dims.w == 1)
+    if(mIsStreaming)
     {
-        type = GL_RED;
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_SWIZZLE_G, GL_RED);
-        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+        initializeSliceTextures();
+    }
+    else
+    {
+        initializeVolumeTexture();
     }
-
-    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    
-    glTexImage3D(GL_TEXTURE_3D, 0, type, dims.x, dims.y, dims.z, 0, type, GL_FLOAT, &mData[0]);
-    glGenerateMipmap(GL_TEXTURE_3D);
 
     glCreateVertexArrays(1, &mVAO);
 
+    // Vertices, texture coordinates and slices share one buffer.
+    std::vector<glm::vec3> attributes(mVertices);
+    attributes.insert(attributes.end(), mTextureCoords.begin(), mTextureCoords.end());
+    attributes.insert(attributes.end(), mSlice.begin(), mSlice.end());
+    mVertexBO = GPU::Buffer(attributes.size() * sizeof(glm::vec3), attributes.data(), 0, "vertices");
+    const GLintptr textureCoordsOffset = mVertices.size() * sizeof(glm::vec3);
+    const GLintptr sliceOffset = textureCoordsOffset + mTextureCoords.size() * sizeof(glm::vec3);
+
     //Bind vertices
     const GLuint verticesIndex = 0;
-    mVerticesBO = genVBO<glm::vec3>(mVertices);
-
     glEnableVertexArrayAttrib(mVAO, verticesIndex);
     glVertexArrayAttribFormat(mVAO, verticesIndex, 3, GL_FLOAT, GL_FALSE, 0);
-    glVertexArrayVertexBuffer(mVAO, verticesIndex, mVerticesBO, 0, sizeof(float)*3);
+    glVertexArrayVertexBuffer(mVAO, verticesIndex, mVertexBO.GetID(), 0, sizeof(float)*3);
     glVertexArrayBindingDivisor(mVAO, verticesIndex, 0);
     glVertexArrayAttribBinding(mVAO, verticesIndex, verticesIndex);
 
     //Bind texture coordinates
     const GLuint texIndex = 1;
-    mTextureCoordsBO = genVBO<glm::vec3>(mTextureCoords);
-
     glEnableVertexArrayAttrib(mVAO, texIndex);
     glVertexArrayAttribFormat(mVAO, texIndex, 3, GL_FLOAT, GL_FALSE, 0);
-    glVertexArrayVertexBuffer(mVAO, texIndex, mTextureCoordsBO, 0, sizeof(float)*3);
+    glVertexArrayVertexBuffer(mVAO, texIndex, mVertexBO.GetID(), textureCoordsOffset, sizeof(float)*3);
     glVertexArrayBindingDivisor(mVAO, texIndex, 0);
     glVertexArrayAttribBinding(mVAO, texIndex, texIndex);
 
     //Bind Slices
     const GLuint sliceIndex = 2;
-    mSliceBO = genVBO<glm::vec3>(mSlice);
-
     glEnableVertexArrayAttrib(mVAO, sliceIndex);
     glVertexArrayAttribFormat(mVAO, sliceIndex, 3, GL_FLOAT, GL_FALSE, 0);
-    glVertexArrayVertexBuffer(mVAO, sliceIndex, mSliceBO, 0, sizeof(float)*3);
+    glVertexArrayVertexBuffer(mVAO, sliceIndex, mVertexBO.GetID(), sliceOffset, sizeof(float)*3);
     glVertexArrayBindingDivisor(mVAO, sliceIndex, 0);
     glVertexArrayAttribBinding(mVAO, sliceIndex, sliceIndex);
 }
 
-template <typename T>
-GLuint Texture::genVBO(const std::vector<T>& data) const
+void Texture::initializeVolumeTexture()
 {
-    GLuint vbo;
-    glCreateBuffers(1, &vbo);
-    glNamedBufferData(vbo, data.size() * sizeof(T), &data[0], GL_STATIC_DRAW);
-    return vbo;
+    glCreateTextures(GL_TEXTURE_3D, 1, &mVolumeTexture);
+    glBindTexture(GL_TEXTURE_3D, mVolumeTexture);
+
+    if (mNbChannels == 1)
+    {
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_SWIZZLE_R, GL_RED);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+    }
+
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    // Sampling is done with GL_NEAREST, mipmaps would never be read.
+    // Rows of 8 and 16 bits texels are not necessarily 4-bytes aligned.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_3D, 0, mInternalFormat, mDims.x, mDims.y, mDims.z, 0,
+                 mPixelFormat, mPixelType, mVolume->GetTexels().data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    const size_t nbTexels = static_cast<size_t>(mDims.x) * mDims.y * mDims.z;
+    mMemoryIds.push_back(Utilities::MemoryRegistry::Instance().Register(
+        Utilities::MemoryRegistry::Kind::gpuTexture, "volume", nbTexels * mTexelSize));
+
+    // The volume now lives on the GPU.
+    mVolume.reset();
+    mState->BackgroundImage.GetMutable().ReleaseVoxelData();
+}
+
+void Texture::initializeSliceTextures()
+{
+    // Texture size for each plane. X: (y, z), Y: (x, z), Z: (x, y).
+    const std::array<glm::ivec2, NB_PLANES> sizes = {
+        glm::ivec2(mDims.y, mDims.z),
+        glm::ivec2(mDims.x, mDims.z),
+        glm::ivec2(mDims.x, mDims.y)
+    };
+    glCreateTextures(GL_TEXTURE_2D, NB_PLANES, mSliceTextures.data());
+    size_t offset = 0;
+    for(unsigned int plane = 0; plane < NB_PLANES; ++plane)
+    {
+        const GLuint texture = mSliceTextures[plane];
+        glTextureStorage2D(texture, 1, mInternalFormat, sizes[plane].x, sizes[plane].y);
+        if(mNbChannels == 1)
+        {
+            glTextureParameteri(texture, GL_TEXTURE_SWIZZLE_G, GL_RED);
+            glTextureParameteri(texture, GL_TEXTURE_SWIZZLE_B, GL_RED);
+        }
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // Black (discarded) until the first slice is uploaded.
+        glClearTexImage(texture, 0, mPixelFormat, mPixelType, nullptr);
+
+        const size_t regionSize = static_cast<size_t>(sizes[plane].x) * sizes[plane].y
+                                * mTexelSize;
+        for(unsigned int region = 0; region < NB_REGIONS_PER_PLANE; ++region)
+        {
+            mRegionOffsets[plane][region] = offset;
+            mRegionFences[plane][region] = nullptr;
+            offset += regionSize;
+        }
+        mNextRegion[plane] = 0;
+        mScheduledSlices[plane] = -1;
+        mIsPlaneBusy[plane] = false;
+    }
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    mStagingBO = GPU::Buffer(offset, nullptr, flags, "slice staging");
+    mStagingPtr = static_cast<char*>(glMapNamedBufferRange(mStagingBO.GetID(), 0, offset, flags));
+
+    // Each plane texture has the size of one of its two staging regions.
+    mMemoryIds.push_back(Utilities::MemoryRegistry::Instance().Register(
+        Utilities::MemoryRegistry::Kind::gpuTexture, "slices", offset / NB_REGIONS_PER_PLANE));
+
+    const glm::ivec3 slices = mState->VoxelGrid.SliceIndices.Get();
+    for(unsigned int plane = 0; plane < NB_PLANES; ++plane)
+    {
+        mRequestedSlices[plane] = getImageSlice(plane, slices[plane]);
+    }
+
+    mStopWorker = false;
+    mWorker = std::thread(&Texture::streamingWorker, this);
+}
+
+void Texture::setSliceIndex(glm::vec3, glm::vec3 indices)
+{
+    for(unsigned int plane = 0; plane < NB_PLANES; ++plane)
+    {
+        mRequestedSlices[plane] = getImageSlice(plane, static_cast<int>(indices[plane]));
+    }
+}
+
+int Texture::getImageSlice(unsigned int plane, int gridSlice) const
+{
+    // Same as the texture coordinate of texture_vert.glsl.
+    const int gridSize = mState->VoxelGrid.VolumeShape.Get()[plane];
+    if(gridSize < 2)
+    {
+        return 0;
+    }
+    const float coord = static_cast<float>(gridSlice) / static_cast<float>(gridSize - 1);
+    return glm::clamp(static_cast<int>(std::lround(coord * (mDims[plane] - 1))), 0, mDims[plane] - 1);
+}
+
+void Texture::streamSlices()
+{
+    std::vector<SliceJob> finishedJobs;
+    {
+        std::lock_guard<std::mutex> lock(mJobsMutex);
+        finishedJobs.swap(mFinishedJobs);
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mStagingBO.GetID());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for(const auto& job : finishedJobs)
+    {
+        GLint width, height;
+        glGetTextureLevelParameteriv(mSliceTextures[job.Plane], 0, GL_TEXTURE_WIDTH, &width);
+        glGetTextureLevelParameteriv(mSliceTextures[job.Plane], 0, GL_TEXTURE_HEIGHT, &height);
+
+        // The source is an offset in the bound unpack buffer.
+        const size_t offset = mRegionOffsets[job.Plane][job.Region];
+        glTextureSubImage2D(mSliceTextures[job.Plane], 0, 0, 0, width, height,
+                            mPixelFormat, mPixelType, reinterpret_cast<const void*>(offset));
+
+        // The region can be written again once the GPU is done reading it.
+        mRegionFences[job.Plane][job.Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        mIsPlaneBusy[job.Plane] = false;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    bool hasNewJobs = false;
+    for(unsigned int plane = 0; plane < NB_PLANES; ++plane)
+    {
+        if(mIsPlaneBusy[plane] || mRequestedSlices[plane] == mScheduledSlices[plane])
+        {
+            continue;
+        }
+
+        const unsigned int region = mNextRegion[plane];
+        GLsync& fence = mRegionFences[plane][region];
+        if(fence != nullptr)
+        {
+            const GLenum status = glClientWaitSync(fence, 0, 0);
+            if(status == GL_TIMEOUT_EXPIRED)
+            {
+                // GPU still reading from this region, try again next frame.
+                continue;
+            }
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+
+        // Only the latest requested slice is copied, intermediate slices
+        // skipped while scrolling are never extracted.
+        SliceJob job;
+        job.Plane = plane;
+        job.SliceIndex = mRequestedSlices[plane];
+        job.Region = region;
+        {
+            std::lock_guard<std::mutex> lock(mJobsMutex);
+            mPendingJobs.push_back(job);
+        }
+        mScheduledSlices[plane] = job.SliceIndex;
+        mIsPlaneBusy[plane] = true;
+        mNextRegion[plane] = (region + 1) % NB_REGIONS_PER_PLANE;
+        hasNewJobs = true;
+    }
+
+    if(hasNewJobs)
+    {
+        mJobsCondition.notify_one();
+    }
+}
+
+void Texture::streamingWorker()
+{
+    while(true)
+    {
+        SliceJob job;
+        {
+            std::unique_lock<std::mutex> lock(mJobsMutex);
+            mJobsCondition.wait(lock, [this]{ return mStopWorker || !mPendingJobs.empty(); });
+            if(mStopWorker)
+            {
+                return;
+            }
+            job = mPendingJobs.front();
+            mPendingJobs.pop_front();
+        }
+
+        copySlice(job);
+
+        std::lock_guard<std::mutex> lock(mJobsMutex);
+        mFinishedJobs.push_back(job);
+    }
+}
+
+void Texture::copySlice(const SliceJob& job) const
+{
+    const size_t dx = mDims.x;
+    const size_t dy = mDims.y;
+    const size_t dz = mDims.z;
+    const size_t texelSize = mTexelSize;
+    const unsigned char* texels = mVolume->GetTexels().data();
+    unsigned char* dst = reinterpret_cast<unsigned char*>(mStagingPtr + mRegionOffsets[job.Plane][job.Region]);
+
+    if(job.Plane == 0)
+    {
+        const size_t i = glm::clamp(job.SliceIndex, 0, mDims.x - 1);
+        for(size_t k = 0; k < dz; ++k)
+        {
+            for(size_t j = 0; j < dy; ++j)
+            {
+                const unsigned char* src = &texels[((k * dy + j) * dx + i) * texelSize];
+                std::memcpy(&dst[(k * dy + j) * texelSize], src, texelSize);
+            }
+        }
+    }
+    else if(job.Plane == 1)
+    {
+        // Rows along x are contiguous in memory.
+        const size_t j = glm::clamp(job.SliceIndex, 0, mDims.y - 1);
+        for(size_t k = 0; k < dz; ++k)
+        {
+            const unsigned char* src = &texels[(k * dy + j) * dx * texelSize];
+            std::memcpy(&dst[k * dx * texelSize], src, dx * texelSize);
+        }
+    }
+    else
+    {
+        // Z slices are contiguous in memory.
+        const size_t k = glm::clamp(job.SliceIndex, 0, mDims.z - 1);
+        const unsigned char* src = &texels[k * dy * dx * texelSize];
+        std::memcpy(dst, src, dx * dy * texelSize);
+    }
+}
+
+void Texture::stopStreamingWorker()
+{
+    if(!mWorker.joinable())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mJobsMutex);
+        mStopWorker = true;
+    }
+    mJobsCondition.notify_one();
+    mWorker.join();
 }
 
 void Texture::drawSpecific()
 {
+    if(mIsStreaming)
+    {
+        streamSlices();
+        glBindTextures(0, NB_PLANES, mSliceTextures.data());
+    }
+    else
+    {
+        glBindTextureUnit(0, mVolumeTexture);
+    }
+
     glDisable(GL_CULL_FACE);
     glBindVertexArray(mVAO);
     glDrawArrays(GL_TRIANGLES, 0, static_cast<int>(mVertices.size()));
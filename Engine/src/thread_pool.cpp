@@ -0,0 +1,55 @@
+#include <thread_pool.h>
+#include <algorithm>
+
+namespace Slicer
+{
+namespace Utilities
+{
+ThreadPool::ThreadPool(unsigned int nbThreads)
+:mWorkers()
+,mTasks()
+,mMutex()
+,mCondition()
+,mIsTerminating(false)
+{
+    nbThreads = std::max(1u, nbThreads);
+    for(unsigned int i = 0; i < nbThreads; ++i)
+    {
+        mWorkers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mIsTerminating = true;
+    }
+    mCondition.notify_all();
+    for(auto& worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    while(true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this]() { return mIsTerminating || !mTasks.empty(); });
+            // Pending tasks are completed before exiting.
+            if(mTasks.empty())
+            {
+                return;
+            }
+            task = std::move(mTasks.front());
+            mTasks.pop();
+        }
+        task();
+    }
+}
+} // namespace Utilities
+} // namespace Slicer